@@ -1,6 +1,7 @@
 /// Implementation of the GF(P) Galois field
 
 #include "SIMD.h"
+#include <type_traits>
 
 #if defined(_M_X64) || defined(_M_AMD64) || defined(__x86_64__)
 #define MY_CPU_AMD64
@@ -247,6 +248,108 @@ template <> constexpr uint64_t GF_Mul<uint64_t,0xFFFFFFFFFFFFFFFF> (uint64_t X,
 #endif
 
 
+// Optimized multiplication for P=0xFFFFFFFF00000001 (the "Goldilocks" prime 2^64-2^32+1).
+// Since 2^64 == 2^32-1 and 2^96 == -1 (mod P), the 128-bit product hi*2^64+lo with hi = hi_hi*2^32+hi_lo
+// is reduced as lo - hi_hi + hi_lo*(2^32-1). Generic GF_Add and GF_Sub are already optimal for this P
+#ifdef MY_CPU_64BIT
+
+// Reduce 128-bit value hi*2^64+lo modulo P
+inline constexpr uint64_t GF_ReduceGoldilocks (uint64_t lo, uint64_t hi)
+{
+    const uint64_t EPSILON = 0xFFFFFFFF;        // 2^64 mod P
+    uint64_t hi_hi = hi >> 32,  hi_lo = hi & EPSILON;
+    uint64_t t0 = lo - hi_hi;
+    t0 -= (lo < hi_hi) * EPSILON;               // borrow of 2^64 is compensated by subtracting 2^64 mod P
+    uint64_t t1 = hi_lo * EPSILON;
+    uint64_t res = t0 + t1;
+    res += (res < t1) * EPSILON;                // carry of 2^64 is replaced by adding 2^64 mod P
+    return res - (res >= 0xFFFFFFFF00000001) * 0xFFFFFFFF00000001;
+}
+
+#if __GNUC__
+template <> constexpr uint64_t GF_Mul<uint64_t,0xFFFFFFFF00000001> (uint64_t X, uint64_t Y)
+{
+    uint128_t res = uint128_t(X) * Y;
+    return GF_ReduceGoldilocks (uint64_t(res), uint64_t(res>>64));
+}
+#elif defined(MSVC_ONLY)
+template <> constexpr uint64_t GF_Mul<uint64_t,0xFFFFFFFF00000001> (uint64_t X, uint64_t Y)
+{
+    uint64_t hi, lo = _umul128(X,Y,&hi);
+    return GF_ReduceGoldilocks (lo, hi);
+}
+#endif
+
+#endif
+
+
+/***********************************************************************************************************************
+*** Multiplication by constant *****************************************************************************************
+************************************************************************************************************************/
+
+// When the same W is multiplied by many X values, we can precompute W_precomp = floor(W*2**32/P)
+// and replace the generic GF_Mul reduction with the cheaper one (Shoup's algorithm)
+template <typename T, T P>
+constexpr T GF_MulConstPrecomp (T W)
+{
+    return sizeof(T)==4?  T((uint64_t(W) << 32) / P) : 0;
+}
+
+// Generic version just ignores the precomputed value
+template <typename T, T P>
+constexpr T GF_MulConst (T X, T W, T)
+{
+    return GF_Mul<T,P> (X, W);
+}
+
+// Shoup's multiplication for P=0xFFF00001: two independent 32*32->64 multiplications followed by the third one,
+// that is shorter dependency chain than in GF_Mul32 and much cheaper than 128-bit product in GF_Mul64
+template <> constexpr uint32_t GF_MulConst<uint32_t,0xFFF00001> (uint32_t X, uint32_t W, uint32_t W_precomp)
+{
+    uint32_t q   = uint32_t((uint64_t(X)*W_precomp) >> 32);   // q == floor(X*W/P) or one less
+    uint64_t res = uint64_t(X)*W - uint64_t(q)*0xFFF00001;     // so 0 <= res < 2*P
+#if (SIMD < SSE2)
+    return uint32_t(res>=0xFFF00001? res-0xFFF00001 : res);    // optimized for scalar/GPU code
+#else
+    return uint32_t(res-0xFFF00001) + (uint32_t((res-0xFFF00001)>>32) & 0xFFF00001);   // optimized for SIMD code
+#endif
+}
+
+
+/***********************************************************************************************************************
+*** Lazy reduction *****************************************************************************************************
+************************************************************************************************************************/
+
+// If 4*P fits into the register, NTT butterflies may keep values only partially reduced, in the [0,4P) range
+// (David Harvey, "Faster arithmetic for number-theoretic transforms"), saving a compare+mask on each GF_Add/GF_Sub.
+// It's enabled for P=0x10001 only: 2*0xFFF00001 doesn't fit into 32 bits, while computations modulo 2^32-1 and 2^64-1
+// are already lazy. Data processed by lazy butterflies should be finally normalized with GF_Normalize.
+template <typename T, T P> struct GF_Lazy                  {static constexpr bool enabled = false;};
+template <>                struct GF_Lazy<uint32_t,0x10001> {static constexpr bool enabled = true;};
+
+// Reduce X from [0,4P) to [0,2P)
+template <typename T, T P>
+constexpr T GF_Reduce2P (T X)
+{
+    return X - (X>=2*P)*(2*P);
+}
+
+// Shoup's multiplication of any 32-bit X by constant, returning result in [0,2P) range (requires 2*P < 2**32)
+template <typename T, T P>
+constexpr T GF_MulConstLazy (T X, T W, T W_precomp)
+{
+    T q = T((uint64_t(X)*W_precomp) >> 32);    // q == floor(X*W/P) or one less
+    return X*W - q*P;                          // computed modulo 2**32, but exact result is in [0,2P)
+}
+
+// Multiplication by constant for P=0x10001 accepts unnormalized X, so it can be applied to the results of lazy butterflies
+template <> constexpr uint32_t GF_MulConst<uint32_t,0x10001> (uint32_t X, uint32_t W, uint32_t W_precomp)
+{
+    uint32_t res = GF_MulConstLazy<uint32_t,0x10001> (X, W, W_precomp);
+    return res - (res>=0x10001)*0x10001;
+}
+
+
 /***********************************************************************************************************************
 *** Extra operations in GF(P) ******************************************************************************************
 ************************************************************************************************************************/
@@ -287,13 +390,21 @@ template <> constexpr uint64_t GF_Root<uint64_t,0xFFFFFFFFFFFFFFFF> (uint64_t N)
     //assert (uint64_t(65536)*3*5*17449) % N  ==  0);
     return GF_Pow<uint64_t,0xFFFFFFFFFFFFFFFF> (main_root, (uint64_t(65536)*3*5*17449) / N);
 }
+template <> constexpr uint64_t GF_Root<uint64_t,0xFFFFFFFF00000001> (uint64_t N)
+{
+    uint64_t main_root = 7;  // root of power P-1 = 2^32*3*5*17*257*65537 in GF(0xFFFFFFFF00000001)
+    //assert (0xFFFFFFFF00000000 % N  ==  0);
+    return GF_Pow<uint64_t,0xFFFFFFFF00000001> (main_root, 0xFFFFFFFF00000000 / N);
+}
 #endif
 
 
+// Inverse is X**(L-1), where L is the Carmichael function of P: P-1 for primary P, 2^16 for P=2^32-1 and 2^16*3*5*17449 for P=2^64-1.
+// In the rings, only the numbers coprime to P have an inverse
 template <typename T, T P>
 constexpr T GF_Inv (T X)
 {
-    return GF_Pow<T,P> (X, P==0xFFFFFFFFFFFFFFFF? 0xFFFFFFFF : P==0xFFFFFFFF? 0xFFFF : P-2);
+    return GF_Pow<T,P> (X, P==0xFFFFFFFFFFFFFFFF? T(uint64_t(65536)*3*5*17449-1) : P==0xFFFFFFFF? 0xFFFF : P-2);
 }
 
 
@@ -312,3 +423,122 @@ constexpr T GF_Normalize (T X)
 {
     return X % P;
 }
+
+// The only unnormalized value in the rings is P itself, so it's just mapped to 0 by the wraparound, that is easily vectorized
+template <> constexpr uint32_t GF_Normalize<uint32_t,0xFFFFFFFF> (uint32_t X)  {return X + (X==0xFFFFFFFF);}
+template <> constexpr uint64_t GF_Normalize<uint64_t,0xFFFFFFFFFFFFFFFF> (uint64_t X)  {return X + (X==0xFFFFFFFFFFFFFFFF);}
+
+// True if results of NTT butterflies should be finally normalized: lazy reduction (see GF_Lazy) and the rings modulo 2^32-1 and 2^64-1
+template <typename T, T P>
+constexpr bool GF_Unnormalized()
+{
+    return GF_Lazy<T,P>::enabled  ||  P==0xFFFFFFFF  ||  P==0xFFFFFFFFFFFFFFFF;
+}
+
+
+/***********************************************************************************************************************
+*** Extension fields GF(p^2) for Mersenne primes p *********************************************************************
+************************************************************************************************************************/
+
+// Order of the multiplicative group of the field, i.e. the NTT orders should divide it.
+// For the rings modulo 2^32-1 and 2^64-1, it's the maximum NTT order supported by GF_Root
+template <typename T, T P>
+constexpr T GF_GroupOrder()
+{
+    return P-1;
+}
+template <> constexpr uint32_t GF_GroupOrder<uint32_t,0xFFFFFFFF>()  {return 65536;}
+#ifdef MY_CPU_64BIT
+template <> constexpr uint64_t GF_GroupOrder<uint64_t,0xFFFFFFFFFFFFFFFF>()  {return uint64_t(65536)*3*5*17449;}
+#endif
+
+
+// For Mersenne primes p = 2^BITS-1, -1 isn't a square (since p%4==3), so GF(p^2) consists of elements a+b*i where i*i == -1,
+// similar to complex numbers. Element is stored as single integer T twice wider than its components: a in the low half, b in the high half.
+// The group order p^2-1 = (p-1)*2^BITS, so the field supports NTT orders up to 2^(BITS+1), as well as 3, 5, 7... dividing p-1.
+// Components are fully reduced, since Mersenne reduction is just a few shifts and adds.
+// Fields are identified by P==p: GF(p^2) with p=2^61-1 uses T=uint128_t, while p=2^31-1 uses T=uint64_t
+template <typename T, int BITS>
+struct GF_Mersenne2
+{
+    using Half = typename std::conditional <sizeof(T)==16, uint64_t, uint32_t>::type;
+    static constexpr Half p = (Half(1) << BITS) - 1;
+    static constexpr int SHIFT = 8*sizeof(Half);
+
+    static constexpr Half Re (T X)  {return Half(X);}
+    static constexpr Half Im (T X)  {return Half(X >> SHIFT);}
+    static constexpr T Pack (Half a, Half b)  {return T(a) | (T(b) << SHIFT);}
+
+    // x mod p for any x < 2^(2*BITS+1)
+    static constexpr Half Reduce (T x)
+    {
+        x = (x & p) + (x >> BITS);      // < 2^(BITS+2)
+        x = (x & p) + (x >> BITS);      // <= p+3
+        return Half(x) - (Half(x) >= p)*p;
+    }
+
+    // Operations in GF(p)
+    static constexpr Half Add (Half a, Half b)  {Half res = a+b;  return res - (res>=p)*p;}
+    static constexpr Half Sub (Half a, Half b)  {Half res = a-b;  return res + (a<b)*p;}
+    static constexpr Half Mul (Half a, Half b)  {return Reduce (T(a)*b);}
+    static constexpr Half Inv (Half a)
+    {
+        Half res = 1;
+        for (Half n = p-2; n; n/=2) {
+            if (n&1)  res = Mul (res, a);
+            a = Mul (a, a);
+        }
+        return res;
+    }
+
+    // Operations in GF(p^2)
+    static constexpr T Add (T X, T Y)  {return Pack (Add (Re(X), Re(Y)),  Add (Im(X), Im(Y)));}
+    static constexpr T Sub (T X, T Y)  {return Pack (Sub (Re(X), Re(Y)),  Sub (Im(X), Im(Y)));}
+
+    // (a+b*i)*(c+d*i) = (a*c-b*d) + (a*d+b*c)*i, where a*c+(p-b)*d and a*d+b*c are reduced only once
+    static constexpr T Mul (T X, T Y)
+    {
+        Half a = Re(X),  b = Im(X),  c = Re(Y),  d = Im(Y);
+        return Pack (Reduce (T(a)*c + T(p-b)*d),  Reduce (T(a)*d + T(b)*c));
+    }
+
+    // 1/(a+b*i) = (a-b*i)/(a*a+b*b)
+    static constexpr T Inv (T X)
+    {
+        Half a = Re(X),  b = Im(X);
+        Half inv_norm = Inv (Reduce (T(a)*a + T(b)*b));
+        return Pack (Mul (a, inv_norm),  Mul (Sub (Half(0), b), inv_norm));
+    }
+};
+
+
+// GF(p^2) with p=2^31-1: the group order is 2^32*3^2*7*11*31*151*331, and 1+12*i is its generator
+template <> constexpr uint64_t GF_Add<uint64_t,0x7FFFFFFF> (uint64_t X, uint64_t Y)  {return GF_Mersenne2<uint64_t,31>::Add (X,Y);}
+template <> constexpr uint64_t GF_Sub<uint64_t,0x7FFFFFFF> (uint64_t X, uint64_t Y)  {return GF_Mersenne2<uint64_t,31>::Sub (X,Y);}
+template <> constexpr uint64_t GF_Mul<uint64_t,0x7FFFFFFF> (uint64_t X, uint64_t Y)  {return GF_Mersenne2<uint64_t,31>::Mul (X,Y);}
+template <> constexpr uint64_t GF_Inv<uint64_t,0x7FFFFFFF> (uint64_t X)              {return GF_Mersenne2<uint64_t,31>::Inv (X);}
+template <> constexpr uint64_t GF_Normalize<uint64_t,0x7FFFFFFF> (uint64_t X)        {return X;}
+template <> constexpr uint64_t GF_GroupOrder<uint64_t,0x7FFFFFFF>()                  {return uint64_t(0x7FFFFFFF)*0x7FFFFFFF - 1;}
+template <> constexpr uint64_t GF_Root<uint64_t,0x7FFFFFFF> (uint64_t N)
+{
+    uint64_t main_root = GF_Mersenne2<uint64_t,31>::Pack (1, 12);
+    //assert (GF_GroupOrder<uint64_t,0x7FFFFFFF>() % N  ==  0);
+    return GF_Pow<uint64_t,0x7FFFFFFF> (main_root, GF_GroupOrder<uint64_t,0x7FFFFFFF>() / N);
+}
+
+
+#if __GNUC__ && defined(MY_CPU_64BIT)
+// GF(p^2) with p=2^61-1: the group order is 2^62*3^2*5^2*7*11*13*31*41*61*151*331*1321, and 1+6*i is its generator
+template <> constexpr uint128_t GF_Add<uint128_t,0x1FFFFFFFFFFFFFFF> (uint128_t X, uint128_t Y)  {return GF_Mersenne2<uint128_t,61>::Add (X,Y);}
+template <> constexpr uint128_t GF_Sub<uint128_t,0x1FFFFFFFFFFFFFFF> (uint128_t X, uint128_t Y)  {return GF_Mersenne2<uint128_t,61>::Sub (X,Y);}
+template <> constexpr uint128_t GF_Mul<uint128_t,0x1FFFFFFFFFFFFFFF> (uint128_t X, uint128_t Y)  {return GF_Mersenne2<uint128_t,61>::Mul (X,Y);}
+template <> constexpr uint128_t GF_Inv<uint128_t,0x1FFFFFFFFFFFFFFF> (uint128_t X)               {return GF_Mersenne2<uint128_t,61>::Inv (X);}
+template <> constexpr uint128_t GF_Normalize<uint128_t,0x1FFFFFFFFFFFFFFF> (uint128_t X)         {return X;}
+template <> constexpr uint128_t GF_GroupOrder<uint128_t,0x1FFFFFFFFFFFFFFF>()                   {return uint128_t(0x1FFFFFFFFFFFFFFF)*0x1FFFFFFFFFFFFFFF - 1;}
+template <> constexpr uint128_t GF_Root<uint128_t,0x1FFFFFFFFFFFFFFF> (uint128_t N)
+{
+    uint128_t main_root = GF_Mersenne2<uint128_t,61>::Pack (1, 6);
+    //assert (GF_GroupOrder<uint128_t,0x1FFFFFFFFFFFFFFF>() % N  ==  0);
+    return GF_Pow<uint128_t,0x1FFFFFFFFFFFFFFF> (main_root, GF_GroupOrder<uint128_t,0x1FFFFFFFFFFFFFFF>() / N);
+}
+#endif
@@ -0,0 +1,798 @@
+/// Vectorized GF(P) kernels processing whole blocks, with runtime selection of SSE2/AVX2/AVX-512 code path
+/// Only P=0xFFF00001 and the ring modulo 2^32-1 have hand-written kernels; other P employ generic code relying on the compiler vectorizer (see -DSIMD)
+
+#include <stdlib.h>
+#include <string.h>
+
+#if (defined(__GNUC__) || defined(_MSC_VER)) && (defined(MY_CPU_AMD64) || defined(_M_IX86) || defined(__i386__))
+#define GF_SIMD_KERNELS
+#include <immintrin.h>
+#endif
+
+#if __GNUC__
+#define TARGET(isa)  __attribute__((target(isa)))
+#else
+#define TARGET(isa)  /* MSVC compiles intrinsics for any ISA */
+#endif
+
+
+/***********************************************************************************************************************
+*** Kernels interface **************************************************************************************************
+************************************************************************************************************************/
+
+// Operations on blocks of SIZE elements:
+//   Butterfly:  (a[k], b[k]) := (a[k] + b[k]*root, a[k] - b[k]*root)
+//   Butterfly1: the same with root==1
+//   Scale:      dst[k] := src[k]*root  (dst may be equal to src)
+//   Radix4/8:   2 or 3 successive butterfly steps on 4 or 8 blocks x[], loading and storing each element only once.
+//               Step l combines blocks j and j+2**l (where bit l of j is zero) with the twiddle factor root[2**l-1 + j%2**l],
+//               so root[] holds 3 or 7 values
+//   Pack:       convert raw 32-bit words into elements of GF(0xFFF00001) in place, storing the masks (see PackBlock)
+//   Unpack:     the reverse conversion with the given masks
+// Generic version is disabled, so callers should use their own scalar code
+template <typename T, T P>
+struct GF_Kernels
+{
+    static constexpr bool enabled = false;
+    static const char* Name()  {return "generic";}
+    static void Butterfly  (T*, T*, size_t, T, T)                {}
+    static void Butterfly1 (T*, T*, size_t)                      {}
+    static void Scale      (T*, const T*, size_t, T, T)          {}
+    static void Radix4     (T**, size_t, const T*, const T*)     {}
+    static void Radix8     (T**, size_t, const T*, const T*)     {}
+    static void Pack       (T*, size_t, uint16_t*)               {}
+    static void Unpack     (T*, size_t, const uint16_t*)         {}
+};
+
+
+// Scalar kernels, used on CPUs without SIMD support and to process the tail of block
+template <typename T, T P>
+void Butterfly_Scalar (T* __restrict__ a, T* __restrict__ b, size_t SIZE, T root, T root_precomp)
+{
+    for (size_t k=0; k<SIZE; k++) {
+        T u = a[k],  v = GF_MulConst<T,P> (b[k], root, root_precomp);
+        a[k] = GF_Add<T,P> (u, v);
+        b[k] = GF_Sub<T,P> (u, v);
+    }
+}
+
+template <typename T, T P>
+void Butterfly1_Scalar (T* __restrict__ a, T* __restrict__ b, size_t SIZE)
+{
+    for (size_t k=0; k<SIZE; k++) {
+        T u = a[k],  v = b[k];
+        a[k] = GF_Add<T,P> (u, v);
+        b[k] = GF_Sub<T,P> (u, v);
+    }
+}
+
+template <typename T, T P>
+void Scale_Scalar (T* dst, const T* src, size_t SIZE, T root, T root_precomp)
+{
+    for (size_t k=0; k<SIZE; k++)
+        dst[k] = GF_MulConst<T,P> (src[k], root, root_precomp);
+}
+
+// Radix-2**R kernel on elements first..SIZE-1 of the blocks
+template <typename T, T P, int R>
+void Radix_Scalar (T** x, size_t first, size_t SIZE, const T* root, const T* root_precomp)
+{
+    const int G = 1<<R;
+    for (size_t k=first; k<SIZE; k++) {
+        T v[G];
+        for (int j=0; j<G; j++)
+            v[j] = x[j][k];
+        for (int l=0; l<R; l++) {
+            for (int j=0; j<G; j++) {
+                if ((j>>l) & 1)  continue;
+                int t = (1<<l) - 1 + (j & ((1<<l) - 1));
+                T u = v[j],  w = GF_MulConst<T,P> (v[j+(1<<l)], root[t], root_precomp[t]);
+                v[j]        = GF_Add<T,P> (u, w);
+                v[j+(1<<l)] = GF_Sub<T,P> (u, w);
+            }
+        }
+        for (int j=0; j<G; j++)
+            x[j][k] = v[j];
+    }
+}
+
+// Check whether any of n words is >= 0xFFF00000, i.e. has all 12 top bits set
+static inline bool Overflow_Scalar (const uint32_t* x, size_t n)
+{
+    uint32_t any = 0;
+    for (size_t k=0; k<n; k++)
+        any |= ((x[k] >> 20) == 0xFFF);
+    return any != 0;
+}
+
+// XOR top 12 bits of n words with the mask
+static inline void Flip_Scalar (uint32_t* x, size_t n, uint32_t mask)
+{
+    for (size_t k=0; k<n; k++)
+        x[k] ^= mask << 20;
+}
+
+
+/***********************************************************************************************************************
+*** Data packing *******************************************************************************************************
+************************************************************************************************************************/
+
+// Raw data are converted into elements of GF(0xFFF00001) in place. The block is split into groups of GF_PACK_GROUP words
+// (the last group may be shorter), and each group gets a 12-bit mask, stored separately from the block.
+// When any word of the group is >= 0xFFF00000, top 12 bits of all its words are XORed with mask = v^0xFFF,
+// where v is any 12-bit value missing in the top bits of the group words (2048 words can't hold all 4096 values),
+// so no word has all top bits set afterwards. Otherwise the mask is 0 and the words are kept intact.
+// Thus all words become < 0xFFF00000 < P, while all bits of the data are kept, and the side band costs 2 bytes per 8 KB of data.
+// Packing with known masks and unpacking are the same XOR pass (UnpackBlock). The common case costs one vectorized scan (Overflow)
+// per group, and the XOR is vectorized too (Flip), so both are cheap enough to be merged into passes over the block made by NTT or decoder
+const size_t GF_PACK_GROUP = 2048;
+
+// True if raw data can be packed into elements of the field, i.e. GF_Kernels<T,P> provide Pack/Unpack
+template <typename T, T P>
+constexpr bool GF_Packable()
+{
+    return sizeof(T)==4  &&  uint64_t(P)==0xFFF00001;
+}
+
+// Number of packing masks per block of SIZE words
+inline size_t GF_PackMasks (size_t SIZE)
+{
+    return (SIZE + GF_PACK_GROUP-1) / GF_PACK_GROUP;
+}
+
+// Pack the block, storing GF_PackMasks(SIZE) masks to masks[]
+template <bool Overflow (const uint32_t*, size_t),  void Flip (uint32_t*, size_t, uint32_t)>
+void PackBlock (uint32_t* block, size_t SIZE, uint16_t* masks)
+{
+    for (size_t first=0; first<SIZE; first+=GF_PACK_GROUP) {
+        uint32_t* x = block + first;
+        size_t n = std::min (GF_PACK_GROUP, SIZE-first);
+        uint32_t mask = 0;
+        if (Overflow (x, n)) {
+            uint64_t used[64] = {0};                            // bitmap of top 12 bits present in the group
+            for (size_t k=0; k<n; k++)
+                used[x[k] >> 26]  |=  uint64_t(1) << ((x[k] >> 20) & 63);
+            uint32_t v = 0;
+            while ((used[v >> 6] >> (v & 63)) & 1)
+                v++;
+            mask = v ^ 0xFFF;
+            Flip (x, n, mask);
+        }
+        *masks++ = uint16_t(mask);
+    }
+}
+
+// XOR groups of the block with their masks, i.e. unpack the block or pack it again with the same masks
+template <void Flip (uint32_t*, size_t, uint32_t)>
+void UnpackBlock (uint32_t* block, size_t SIZE, const uint16_t* masks)
+{
+    for (size_t first=0; first<SIZE; first+=GF_PACK_GROUP) {
+        uint32_t mask = *masks++;
+        if (mask)  Flip (block + first, std::min (GF_PACK_GROUP, SIZE-first), mask);
+    }
+}
+
+
+#ifdef GF_SIMD_KERNELS
+
+/***********************************************************************************************************************
+*** SSE2 kernels for P=0xFFF00001 and P=0xFFFFFFFF *********************************************************************
+************************************************************************************************************************/
+
+// GF_MulConst on 4 values: Shoup's algorithm with PMULUDQ computing 64-bit products of even and odd lanes separately
+template <uint32_t P>
+static inline TARGET("sse2") __m128i MulConst_SSE2 (__m128i x, __m128i w, __m128i w_precomp, __m128i p)
+{
+    const __m128i lo32 = _mm_set1_epi64x (0xFFFFFFFF);
+    __m128i x_odd  = _mm_srli_epi64 (x, 32);
+    __m128i q_even = _mm_srli_epi64 (_mm_mul_epu32 (x,     w_precomp), 32);
+    __m128i q_odd  = _mm_srli_epi64 (_mm_mul_epu32 (x_odd, w_precomp), 32);
+    __m128i r_even = _mm_sub_epi64 (_mm_mul_epu32 (x,     w), _mm_mul_epu32 (q_even, p));   // 0 <= r < 2*P
+    __m128i r_odd  = _mm_sub_epi64 (_mm_mul_epu32 (x_odd, w), _mm_mul_epu32 (q_odd,  p));
+    r_even = _mm_sub_epi64 (r_even, _mm_and_si128 (p, lo32));       // r-P: low dword is the result if r>=P,
+    r_odd  = _mm_sub_epi64 (r_odd,  _mm_and_si128 (p, lo32));       // high dword is 0 if r>=P and -1 otherwise
+    __m128i lo = _mm_or_si128 (_mm_and_si128 (r_even, lo32),  _mm_slli_epi64 (r_odd, 32));
+    __m128i hi = _mm_or_si128 (_mm_srli_epi64 (r_even, 32),   _mm_andnot_si128 (lo32, r_odd));
+    return _mm_add_epi32 (lo, _mm_and_si128 (hi, p));
+}
+
+// GF_Sub on 4 values: unsigned comparison emulated by flipping the sign bits
+template <uint32_t P>
+static inline TARGET("sse2") __m128i Sub_SSE2 (__m128i x, __m128i y, __m128i p)
+{
+    const __m128i sign = _mm_set1_epi32 (0x80000000);
+    __m128i borrow = _mm_cmpgt_epi32 (_mm_xor_si128 (y, sign), _mm_xor_si128 (x, sign));
+    return _mm_add_epi32 (_mm_sub_epi32 (x, y), _mm_and_si128 (borrow, p));
+}
+
+template <uint32_t P>
+static inline TARGET("sse2") __m128i Add_SSE2 (__m128i x, __m128i y, __m128i p)
+{
+    return Sub_SSE2<P> (x, _mm_sub_epi32 (p, y), p);
+}
+
+// Operations modulo 2^32-1, producing the same (unnormalized) values as the scalar GF_Add/GF_Sub/GF_Mul.
+// The carry out of x+y is added back, x-y is computed as x+~y, and the product hi*2**32+lo is reduced to lo+hi,
+// so the precomputed value isn't used
+template <>
+inline TARGET("sse2") __m128i Add_SSE2<0xFFFFFFFF> (__m128i x, __m128i y, __m128i)
+{
+    const __m128i sign = _mm_set1_epi32 (0x80000000);
+    __m128i res = _mm_add_epi32 (x, y);
+    __m128i carry = _mm_cmpgt_epi32 (_mm_xor_si128 (x, sign), _mm_xor_si128 (res, sign));
+    return _mm_sub_epi32 (res, carry);
+}
+
+template <>
+inline TARGET("sse2") __m128i Sub_SSE2<0xFFFFFFFF> (__m128i x, __m128i y, __m128i p)
+{
+    return Add_SSE2<0xFFFFFFFF> (x, _mm_xor_si128 (y, _mm_set1_epi32 (-1)), p);
+}
+
+template <>
+inline TARGET("sse2") __m128i MulConst_SSE2<0xFFFFFFFF> (__m128i x, __m128i w, __m128i, __m128i p)
+{
+    const __m128i lo32 = _mm_set1_epi64x (0xFFFFFFFF);
+    __m128i r_even = _mm_mul_epu32 (x, w),  r_odd = _mm_mul_epu32 (_mm_srli_epi64 (x, 32), w);
+    __m128i lo = _mm_or_si128 (_mm_and_si128 (r_even, lo32),  _mm_slli_epi64 (r_odd, 32));
+    __m128i hi = _mm_or_si128 (_mm_srli_epi64 (r_even, 32),   _mm_andnot_si128 (lo32, r_odd));
+    return Add_SSE2<0xFFFFFFFF> (lo, hi, p);
+}
+
+template <uint32_t P>
+TARGET("sse2") void Butterfly_SSE2 (uint32_t* __restrict__ a, uint32_t* __restrict__ b, size_t SIZE, uint32_t root, uint32_t root_precomp)
+{
+    const __m128i p = _mm_set1_epi32(P),  w = _mm_set1_epi32(root),  wp = _mm_set1_epi32(root_precomp);
+    size_t k = 0;
+    for (; k+4 <= SIZE; k+=4) {
+        __m128i u = _mm_loadu_si128 ((__m128i*)(a+k));
+        __m128i v = MulConst_SSE2<P> (_mm_loadu_si128 ((__m128i*)(b+k)), w, wp, p);
+        _mm_storeu_si128 ((__m128i*)(a+k), Add_SSE2<P> (u, v, p));
+        _mm_storeu_si128 ((__m128i*)(b+k), Sub_SSE2<P> (u, v, p));
+    }
+    Butterfly_Scalar<uint32_t,P> (a+k, b+k, SIZE-k, root, root_precomp);
+}
+
+template <uint32_t P>
+TARGET("sse2") void Butterfly1_SSE2 (uint32_t* __restrict__ a, uint32_t* __restrict__ b, size_t SIZE)
+{
+    const __m128i p = _mm_set1_epi32(P);
+    size_t k = 0;
+    for (; k+4 <= SIZE; k+=4) {
+        __m128i u = _mm_loadu_si128 ((__m128i*)(a+k));
+        __m128i v = _mm_loadu_si128 ((__m128i*)(b+k));
+        _mm_storeu_si128 ((__m128i*)(a+k), Add_SSE2<P> (u, v, p));
+        _mm_storeu_si128 ((__m128i*)(b+k), Sub_SSE2<P> (u, v, p));
+    }
+    Butterfly1_Scalar<uint32_t,P> (a+k, b+k, SIZE-k);
+}
+
+template <uint32_t P>
+TARGET("sse2") void Scale_SSE2 (uint32_t* dst, const uint32_t* src, size_t SIZE, uint32_t root, uint32_t root_precomp)
+{
+    const __m128i p = _mm_set1_epi32(P),  w = _mm_set1_epi32(root),  wp = _mm_set1_epi32(root_precomp);
+    size_t k = 0;
+    for (; k+4 <= SIZE; k+=4)
+        _mm_storeu_si128 ((__m128i*)(dst+k), MulConst_SSE2<P> (_mm_loadu_si128 ((__m128i*)(src+k)), w, wp, p));
+    Scale_Scalar<uint32_t,P> (dst+k, src+k, SIZE-k, root, root_precomp);
+}
+
+// Order-2 NTT with twiddle factor on 4 values held in registers, employed by the radix-4/8 kernels
+template <uint32_t P>
+static inline TARGET("sse2") void NTT2_SSE2 (__m128i& a, __m128i& b, __m128i w, __m128i w_precomp, __m128i p)
+{
+    __m128i v = MulConst_SSE2<P> (b, w, w_precomp, p);
+    b = Sub_SSE2<P> (a, v, p);
+    a = Add_SSE2<P> (a, v, p);
+}
+
+// Radix-4 kernel: 2 butterfly steps on 4 blocks, each element is loaded and stored once, and all twiddle factors are kept in registers
+template <uint32_t P>
+TARGET("sse2") void Radix4_SSE2 (uint32_t** x, size_t SIZE, const uint32_t* root, const uint32_t* root_precomp)
+{
+    const __m128i p = _mm_set1_epi32(P);
+    const __m128i w0 = _mm_set1_epi32(root[0]),  w1 = _mm_set1_epi32(root[1]),  w2 = _mm_set1_epi32(root[2]);
+    const __m128i wp0 = _mm_set1_epi32(root_precomp[0]),  wp1 = _mm_set1_epi32(root_precomp[1]),  wp2 = _mm_set1_epi32(root_precomp[2]);
+    uint32_t *x0 = x[0],  *x1 = x[1],  *x2 = x[2],  *x3 = x[3];
+    size_t k = 0;
+    for (; k+4 <= SIZE; k+=4) {
+        __m128i v0 = _mm_loadu_si128 ((__m128i*)(x0+k)),  v1 = _mm_loadu_si128 ((__m128i*)(x1+k)),  v2 = _mm_loadu_si128 ((__m128i*)(x2+k)),  v3 = _mm_loadu_si128 ((__m128i*)(x3+k));
+        NTT2_SSE2<P> (v0, v1, w0, wp0, p);   NTT2_SSE2<P> (v2, v3, w0, wp0, p);
+        NTT2_SSE2<P> (v0, v2, w1, wp1, p);   NTT2_SSE2<P> (v1, v3, w2, wp2, p);
+        _mm_storeu_si128 ((__m128i*)(x0+k), v0);  _mm_storeu_si128 ((__m128i*)(x1+k), v1);
+        _mm_storeu_si128 ((__m128i*)(x2+k), v2);  _mm_storeu_si128 ((__m128i*)(x3+k), v3);
+    }
+    Radix_Scalar<uint32_t,P,2> (x, k, SIZE, root, root_precomp);
+}
+
+// Radix-8 kernel: 3 butterfly steps on 8 blocks
+template <uint32_t P>
+TARGET("sse2") void Radix8_SSE2 (uint32_t** x, size_t SIZE, const uint32_t* root, const uint32_t* root_precomp)
+{
+    const __m128i p = _mm_set1_epi32(P);
+    __m128i w[7], wp[7];
+    for (int t=0; t<7; t++)
+        w[t] = _mm_set1_epi32(root[t]),  wp[t] = _mm_set1_epi32(root_precomp[t]);
+    uint32_t *x0 = x[0],  *x1 = x[1],  *x2 = x[2],  *x3 = x[3],  *x4 = x[4],  *x5 = x[5],  *x6 = x[6],  *x7 = x[7];
+    size_t k = 0;
+    for (; k+4 <= SIZE; k+=4) {
+        __m128i v0 = _mm_loadu_si128 ((__m128i*)(x0+k)),  v1 = _mm_loadu_si128 ((__m128i*)(x1+k)),  v2 = _mm_loadu_si128 ((__m128i*)(x2+k)),  v3 = _mm_loadu_si128 ((__m128i*)(x3+k));
+        __m128i v4 = _mm_loadu_si128 ((__m128i*)(x4+k)),  v5 = _mm_loadu_si128 ((__m128i*)(x5+k)),  v6 = _mm_loadu_si128 ((__m128i*)(x6+k)),  v7 = _mm_loadu_si128 ((__m128i*)(x7+k));
+        NTT2_SSE2<P> (v0, v1, w[0], wp[0], p);   NTT2_SSE2<P> (v2, v3, w[0], wp[0], p);   NTT2_SSE2<P> (v4, v5, w[0], wp[0], p);   NTT2_SSE2<P> (v6, v7, w[0], wp[0], p);
+        NTT2_SSE2<P> (v0, v2, w[1], wp[1], p);   NTT2_SSE2<P> (v1, v3, w[2], wp[2], p);   NTT2_SSE2<P> (v4, v6, w[1], wp[1], p);   NTT2_SSE2<P> (v5, v7, w[2], wp[2], p);
+        NTT2_SSE2<P> (v0, v4, w[3], wp[3], p);   NTT2_SSE2<P> (v1, v5, w[4], wp[4], p);   NTT2_SSE2<P> (v2, v6, w[5], wp[5], p);   NTT2_SSE2<P> (v3, v7, w[6], wp[6], p);
+        _mm_storeu_si128 ((__m128i*)(x0+k), v0);  _mm_storeu_si128 ((__m128i*)(x1+k), v1);  _mm_storeu_si128 ((__m128i*)(x2+k), v2);  _mm_storeu_si128 ((__m128i*)(x3+k), v3);
+        _mm_storeu_si128 ((__m128i*)(x4+k), v4);  _mm_storeu_si128 ((__m128i*)(x5+k), v5);  _mm_storeu_si128 ((__m128i*)(x6+k), v6);  _mm_storeu_si128 ((__m128i*)(x7+k), v7);
+    }
+    Radix_Scalar<uint32_t,P,3> (x, k, SIZE, root, root_precomp);
+}
+
+// Scan and flip primitives for PackBlock/UnpackBlock
+static inline TARGET("sse2") bool Overflow_SSE2 (const uint32_t* x, size_t n)
+{
+    const __m128i top = _mm_set1_epi32 (0xFFF);
+    __m128i any = _mm_setzero_si128();
+    size_t k = 0;
+    for (; k+4 <= n; k+=4)
+        any = _mm_or_si128 (any, _mm_cmpeq_epi32 (_mm_srli_epi32 (_mm_loadu_si128 ((__m128i*)(x+k)), 20), top));
+    return _mm_movemask_epi8 (any)  ||  Overflow_Scalar (x+k, n-k);
+}
+
+static inline TARGET("sse2") void Flip_SSE2 (uint32_t* x, size_t n, uint32_t mask)
+{
+    const __m128i m = _mm_set1_epi32 (mask << 20);
+    size_t k = 0;
+    for (; k+4 <= n; k+=4)
+        _mm_storeu_si128 ((__m128i*)(x+k), _mm_xor_si128 (_mm_loadu_si128 ((__m128i*)(x+k)), m));
+    Flip_Scalar (x+k, n-k, mask);
+}
+
+
+
+/***********************************************************************************************************************
+*** AVX2 kernels for P=0xFFF00001 and P=0xFFFFFFFF *********************************************************************
+************************************************************************************************************************/
+
+// The same algorithm as MulConst_SSE2, but on 8 values and using VPBLENDD to combine even and odd lanes
+template <uint32_t P>
+static inline TARGET("avx2") __m256i MulConst_AVX2 (__m256i x, __m256i w, __m256i w_precomp, __m256i p)
+{
+    const __m256i p64 = _mm256_and_si256 (p, _mm256_set1_epi64x (0xFFFFFFFF));
+    __m256i x_odd  = _mm256_srli_epi64 (x, 32);
+    __m256i q_even = _mm256_srli_epi64 (_mm256_mul_epu32 (x,     w_precomp), 32);
+    __m256i q_odd  = _mm256_srli_epi64 (_mm256_mul_epu32 (x_odd, w_precomp), 32);
+    __m256i r_even = _mm256_sub_epi64 (_mm256_mul_epu32 (x,     w), _mm256_mul_epu32 (q_even, p));   // 0 <= r < 2*P
+    __m256i r_odd  = _mm256_sub_epi64 (_mm256_mul_epu32 (x_odd, w), _mm256_mul_epu32 (q_odd,  p));
+    r_even = _mm256_sub_epi64 (r_even, p64);
+    r_odd  = _mm256_sub_epi64 (r_odd,  p64);
+    __m256i lo = _mm256_blend_epi32 (r_even, _mm256_slli_epi64 (r_odd, 32), 0xAA);
+    __m256i hi = _mm256_blend_epi32 (_mm256_srli_epi64 (r_even, 32), r_odd, 0xAA);
+    return _mm256_add_epi32 (lo, _mm256_and_si256 (hi, p));
+}
+
+template <uint32_t P>
+static inline TARGET("avx2") __m256i Sub_AVX2 (__m256i x, __m256i y, __m256i p)
+{
+    __m256i no_borrow = _mm256_cmpeq_epi32 (_mm256_max_epu32 (x, y), x);    // x>=y
+    return _mm256_add_epi32 (_mm256_sub_epi32 (x, y), _mm256_andnot_si256 (no_borrow, p));
+}
+
+template <uint32_t P>
+static inline TARGET("avx2") __m256i Add_AVX2 (__m256i x, __m256i y, __m256i p)
+{
+    return Sub_AVX2<P> (x, _mm256_sub_epi32 (p, y), p);
+}
+
+// Operations modulo 2^32-1, see Add_SSE2<0xFFFFFFFF>. The carry is added back as no_carry+1, where no_carry is 0 or -1
+template <>
+inline TARGET("avx2") __m256i Add_AVX2<0xFFFFFFFF> (__m256i x, __m256i y, __m256i)
+{
+    __m256i res = _mm256_add_epi32 (x, y);
+    __m256i no_carry = _mm256_cmpeq_epi32 (_mm256_max_epu32 (x, res), res);    // res>=x
+    return _mm256_add_epi32 (res, _mm256_add_epi32 (no_carry, _mm256_set1_epi32 (1)));
+}
+
+template <>
+inline TARGET("avx2") __m256i Sub_AVX2<0xFFFFFFFF> (__m256i x, __m256i y, __m256i p)
+{
+    return Add_AVX2<0xFFFFFFFF> (x, _mm256_xor_si256 (y, _mm256_set1_epi32 (-1)), p);
+}
+
+template <>
+inline TARGET("avx2") __m256i MulConst_AVX2<0xFFFFFFFF> (__m256i x, __m256i w, __m256i, __m256i p)
+{
+    __m256i r_even = _mm256_mul_epu32 (x, w),  r_odd = _mm256_mul_epu32 (_mm256_srli_epi64 (x, 32), w);
+    __m256i lo = _mm256_blend_epi32 (r_even, _mm256_slli_epi64 (r_odd, 32), 0xAA);
+    __m256i hi = _mm256_blend_epi32 (_mm256_srli_epi64 (r_even, 32), r_odd, 0xAA);
+    return Add_AVX2<0xFFFFFFFF> (lo, hi, p);
+}
+
+template <uint32_t P>
+TARGET("avx2") void Butterfly_AVX2 (uint32_t* __restrict__ a, uint32_t* __restrict__ b, size_t SIZE, uint32_t root, uint32_t root_precomp)
+{
+    const __m256i p = _mm256_set1_epi32(P),  w = _mm256_set1_epi32(root),  wp = _mm256_set1_epi32(root_precomp);
+    size_t k = 0;
+    for (; k+8 <= SIZE; k+=8) {
+        __m256i u = _mm256_loadu_si256 ((__m256i*)(a+k));
+        __m256i v = MulConst_AVX2<P> (_mm256_loadu_si256 ((__m256i*)(b+k)), w, wp, p);
+        _mm256_storeu_si256 ((__m256i*)(a+k), Add_AVX2<P> (u, v, p));
+        _mm256_storeu_si256 ((__m256i*)(b+k), Sub_AVX2<P> (u, v, p));
+    }
+    Butterfly_Scalar<uint32_t,P> (a+k, b+k, SIZE-k, root, root_precomp);
+}
+
+template <uint32_t P>
+TARGET("avx2") void Butterfly1_AVX2 (uint32_t* __restrict__ a, uint32_t* __restrict__ b, size_t SIZE)
+{
+    const __m256i p = _mm256_set1_epi32(P);
+    size_t k = 0;
+    for (; k+8 <= SIZE; k+=8) {
+        __m256i u = _mm256_loadu_si256 ((__m256i*)(a+k));
+        __m256i v = _mm256_loadu_si256 ((__m256i*)(b+k));
+        _mm256_storeu_si256 ((__m256i*)(a+k), Add_AVX2<P> (u, v, p));
+        _mm256_storeu_si256 ((__m256i*)(b+k), Sub_AVX2<P> (u, v, p));
+    }
+    Butterfly1_Scalar<uint32_t,P> (a+k, b+k, SIZE-k);
+}
+
+template <uint32_t P>
+TARGET("avx2") void Scale_AVX2 (uint32_t* dst, const uint32_t* src, size_t SIZE, uint32_t root, uint32_t root_precomp)
+{
+    const __m256i p = _mm256_set1_epi32(P),  w = _mm256_set1_epi32(root),  wp = _mm256_set1_epi32(root_precomp);
+    size_t k = 0;
+    for (; k+8 <= SIZE; k+=8)
+        _mm256_storeu_si256 ((__m256i*)(dst+k), MulConst_AVX2<P> (_mm256_loadu_si256 ((__m256i*)(src+k)), w, wp, p));
+    Scale_Scalar<uint32_t,P> (dst+k, src+k, SIZE-k, root, root_precomp);
+}
+
+// Order-2 NTT with twiddle factor on 8 values held in registers, employed by the radix-4/8 kernels
+template <uint32_t P>
+static inline TARGET("avx2") void NTT2_AVX2 (__m256i& a, __m256i& b, __m256i w, __m256i w_precomp, __m256i p)
+{
+    __m256i v = MulConst_AVX2<P> (b, w, w_precomp, p);
+    b = Sub_AVX2<P> (a, v, p);
+    a = Add_AVX2<P> (a, v, p);
+}
+
+// Radix-4 kernel: 2 butterfly steps on 4 blocks, each element is loaded and stored once, and all twiddle factors are kept in registers
+template <uint32_t P>
+TARGET("avx2") void Radix4_AVX2 (uint32_t** x, size_t SIZE, const uint32_t* root, const uint32_t* root_precomp)
+{
+    const __m256i p = _mm256_set1_epi32(P);
+    const __m256i w0 = _mm256_set1_epi32(root[0]),  w1 = _mm256_set1_epi32(root[1]),  w2 = _mm256_set1_epi32(root[2]);
+    const __m256i wp0 = _mm256_set1_epi32(root_precomp[0]),  wp1 = _mm256_set1_epi32(root_precomp[1]),  wp2 = _mm256_set1_epi32(root_precomp[2]);
+    uint32_t *x0 = x[0],  *x1 = x[1],  *x2 = x[2],  *x3 = x[3];
+    size_t k = 0;
+    for (; k+8 <= SIZE; k+=8) {
+        __m256i v0 = _mm256_loadu_si256 ((__m256i*)(x0+k)),  v1 = _mm256_loadu_si256 ((__m256i*)(x1+k)),  v2 = _mm256_loadu_si256 ((__m256i*)(x2+k)),  v3 = _mm256_loadu_si256 ((__m256i*)(x3+k));
+        NTT2_AVX2<P> (v0, v1, w0, wp0, p);   NTT2_AVX2<P> (v2, v3, w0, wp0, p);
+        NTT2_AVX2<P> (v0, v2, w1, wp1, p);   NTT2_AVX2<P> (v1, v3, w2, wp2, p);
+        _mm256_storeu_si256 ((__m256i*)(x0+k), v0);  _mm256_storeu_si256 ((__m256i*)(x1+k), v1);
+        _mm256_storeu_si256 ((__m256i*)(x2+k), v2);  _mm256_storeu_si256 ((__m256i*)(x3+k), v3);
+    }
+    Radix_Scalar<uint32_t,P,2> (x, k, SIZE, root, root_precomp);
+}
+
+// Radix-8 kernel: 3 butterfly steps on 8 blocks
+template <uint32_t P>
+TARGET("avx2") void Radix8_AVX2 (uint32_t** x, size_t SIZE, const uint32_t* root, const uint32_t* root_precomp)
+{
+    const __m256i p = _mm256_set1_epi32(P);
+    __m256i w[7], wp[7];
+    for (int t=0; t<7; t++)
+        w[t] = _mm256_set1_epi32(root[t]),  wp[t] = _mm256_set1_epi32(root_precomp[t]);
+    uint32_t *x0 = x[0],  *x1 = x[1],  *x2 = x[2],  *x3 = x[3],  *x4 = x[4],  *x5 = x[5],  *x6 = x[6],  *x7 = x[7];
+    size_t k = 0;
+    for (; k+8 <= SIZE; k+=8) {
+        __m256i v0 = _mm256_loadu_si256 ((__m256i*)(x0+k)),  v1 = _mm256_loadu_si256 ((__m256i*)(x1+k)),  v2 = _mm256_loadu_si256 ((__m256i*)(x2+k)),  v3 = _mm256_loadu_si256 ((__m256i*)(x3+k));
+        __m256i v4 = _mm256_loadu_si256 ((__m256i*)(x4+k)),  v5 = _mm256_loadu_si256 ((__m256i*)(x5+k)),  v6 = _mm256_loadu_si256 ((__m256i*)(x6+k)),  v7 = _mm256_loadu_si256 ((__m256i*)(x7+k));
+        NTT2_AVX2<P> (v0, v1, w[0], wp[0], p);   NTT2_AVX2<P> (v2, v3, w[0], wp[0], p);   NTT2_AVX2<P> (v4, v5, w[0], wp[0], p);   NTT2_AVX2<P> (v6, v7, w[0], wp[0], p);
+        NTT2_AVX2<P> (v0, v2, w[1], wp[1], p);   NTT2_AVX2<P> (v1, v3, w[2], wp[2], p);   NTT2_AVX2<P> (v4, v6, w[1], wp[1], p);   NTT2_AVX2<P> (v5, v7, w[2], wp[2], p);
+        NTT2_AVX2<P> (v0, v4, w[3], wp[3], p);   NTT2_AVX2<P> (v1, v5, w[4], wp[4], p);   NTT2_AVX2<P> (v2, v6, w[5], wp[5], p);   NTT2_AVX2<P> (v3, v7, w[6], wp[6], p);
+        _mm256_storeu_si256 ((__m256i*)(x0+k), v0);  _mm256_storeu_si256 ((__m256i*)(x1+k), v1);  _mm256_storeu_si256 ((__m256i*)(x2+k), v2);  _mm256_storeu_si256 ((__m256i*)(x3+k), v3);
+        _mm256_storeu_si256 ((__m256i*)(x4+k), v4);  _mm256_storeu_si256 ((__m256i*)(x5+k), v5);  _mm256_storeu_si256 ((__m256i*)(x6+k), v6);  _mm256_storeu_si256 ((__m256i*)(x7+k), v7);
+    }
+    Radix_Scalar<uint32_t,P,3> (x, k, SIZE, root, root_precomp);
+}
+
+// Scan and flip primitives for PackBlock/UnpackBlock
+static inline TARGET("avx2") bool Overflow_AVX2 (const uint32_t* x, size_t n)
+{
+    const __m256i top = _mm256_set1_epi32 (0xFFF);
+    __m256i any = _mm256_setzero_si256();
+    size_t k = 0;
+    for (; k+8 <= n; k+=8)
+        any = _mm256_or_si256 (any, _mm256_cmpeq_epi32 (_mm256_srli_epi32 (_mm256_loadu_si256 ((__m256i*)(x+k)), 20), top));
+    return !_mm256_testz_si256 (any, any)  ||  Overflow_Scalar (x+k, n-k);
+}
+
+static inline TARGET("avx2") void Flip_AVX2 (uint32_t* x, size_t n, uint32_t mask)
+{
+    const __m256i m = _mm256_set1_epi32 (mask << 20);
+    size_t k = 0;
+    for (; k+8 <= n; k+=8)
+        _mm256_storeu_si256 ((__m256i*)(x+k), _mm256_xor_si256 (_mm256_loadu_si256 ((__m256i*)(x+k)), m));
+    Flip_Scalar (x+k, n-k, mask);
+}
+
+
+
+/***********************************************************************************************************************
+*** AVX-512 kernels for P=0xFFF00001 and P=0xFFFFFFFF ******************************************************************
+************************************************************************************************************************/
+
+// AVX-512 has unsigned comparisons and masked operations, so final corrections are much simpler
+template <uint32_t P>
+static inline TARGET("avx512f") __m512i MulConst_AVX512 (__m512i x, __m512i w, __m512i w_precomp, __m512i p)
+{
+    const __m512i p64 = _mm512_and_si512 (p, _mm512_set1_epi64 (0xFFFFFFFF));
+    __m512i x_odd  = _mm512_srli_epi64 (x, 32);
+    __m512i q_even = _mm512_srli_epi64 (_mm512_mul_epu32 (x,     w_precomp), 32);
+    __m512i q_odd  = _mm512_srli_epi64 (_mm512_mul_epu32 (x_odd, w_precomp), 32);
+    __m512i r_even = _mm512_sub_epi64 (_mm512_mul_epu32 (x,     w), _mm512_mul_epu32 (q_even, p));   // 0 <= r < 2*P
+    __m512i r_odd  = _mm512_sub_epi64 (_mm512_mul_epu32 (x_odd, w), _mm512_mul_epu32 (q_odd,  p));
+    r_even = _mm512_mask_sub_epi64 (r_even, _mm512_cmpge_epu64_mask (r_even, p64), r_even, p64);
+    r_odd  = _mm512_mask_sub_epi64 (r_odd,  _mm512_cmpge_epu64_mask (r_odd,  p64), r_odd,  p64);
+    return _mm512_mask_blend_epi32 (0xAAAA, r_even, _mm512_slli_epi64 (r_odd, 32));
+}
+
+template <uint32_t P>
+static inline TARGET("avx512f") __m512i Sub_AVX512 (__m512i x, __m512i y, __m512i p)
+{
+    __m512i res = _mm512_sub_epi32 (x, y);
+    return _mm512_mask_add_epi32 (res, _mm512_cmplt_epu32_mask (x, y), res, p);
+}
+
+template <uint32_t P>
+static inline TARGET("avx512f") __m512i Add_AVX512 (__m512i x, __m512i y, __m512i p)
+{
+    __m512i res = _mm512_add_epi32 (x, y);    // subtract P on overflow or if res>=P
+    __mmask16 k = _mm512_cmplt_epu32_mask (res, x) | _mm512_cmpge_epu32_mask (res, p);
+    return _mm512_mask_sub_epi32 (res, k, res, p);
+}
+
+// Operations modulo 2^32-1, see Add_SSE2<0xFFFFFFFF>
+template <>
+inline TARGET("avx512f") __m512i Add_AVX512<0xFFFFFFFF> (__m512i x, __m512i y, __m512i)
+{
+    __m512i res = _mm512_add_epi32 (x, y);    // add the carry back
+    return _mm512_mask_add_epi32 (res, _mm512_cmplt_epu32_mask (res, x), res, _mm512_set1_epi32 (1));
+}
+
+template <>
+inline TARGET("avx512f") __m512i Sub_AVX512<0xFFFFFFFF> (__m512i x, __m512i y, __m512i p)
+{
+    return Add_AVX512<0xFFFFFFFF> (x, _mm512_xor_si512 (y, _mm512_set1_epi32 (-1)), p);
+}
+
+template <>
+inline TARGET("avx512f") __m512i MulConst_AVX512<0xFFFFFFFF> (__m512i x, __m512i w, __m512i, __m512i p)
+{
+    __m512i r_even = _mm512_mul_epu32 (x, w),  r_odd = _mm512_mul_epu32 (_mm512_srli_epi64 (x, 32), w);
+    __m512i lo = _mm512_mask_blend_epi32 (0xAAAA, r_even, _mm512_slli_epi64 (r_odd, 32));
+    __m512i hi = _mm512_mask_blend_epi32 (0xAAAA, _mm512_srli_epi64 (r_even, 32), r_odd);
+    return Add_AVX512<0xFFFFFFFF> (lo, hi, p);
+}
+
+template <uint32_t P>
+TARGET("avx512f") void Butterfly_AVX512 (uint32_t* __restrict__ a, uint32_t* __restrict__ b, size_t SIZE, uint32_t root, uint32_t root_precomp)
+{
+    const __m512i p = _mm512_set1_epi32(P),  w = _mm512_set1_epi32(root),  wp = _mm512_set1_epi32(root_precomp);
+    size_t k = 0;
+    for (; k+16 <= SIZE; k+=16) {
+        __m512i u = _mm512_loadu_si512 (a+k);
+        __m512i v = MulConst_AVX512<P> (_mm512_loadu_si512 (b+k), w, wp, p);
+        _mm512_storeu_si512 (a+k, Add_AVX512<P> (u, v, p));
+        _mm512_storeu_si512 (b+k, Sub_AVX512<P> (u, v, p));
+    }
+    Butterfly_Scalar<uint32_t,P> (a+k, b+k, SIZE-k, root, root_precomp);
+}
+
+template <uint32_t P>
+TARGET("avx512f") void Butterfly1_AVX512 (uint32_t* __restrict__ a, uint32_t* __restrict__ b, size_t SIZE)
+{
+    const __m512i p = _mm512_set1_epi32(P);
+    size_t k = 0;
+    for (; k+16 <= SIZE; k+=16) {
+        __m512i u = _mm512_loadu_si512 (a+k);
+        __m512i v = _mm512_loadu_si512 (b+k);
+        _mm512_storeu_si512 (a+k, Add_AVX512<P> (u, v, p));
+        _mm512_storeu_si512 (b+k, Sub_AVX512<P> (u, v, p));
+    }
+    Butterfly1_Scalar<uint32_t,P> (a+k, b+k, SIZE-k);
+}
+
+template <uint32_t P>
+TARGET("avx512f") void Scale_AVX512 (uint32_t* dst, const uint32_t* src, size_t SIZE, uint32_t root, uint32_t root_precomp)
+{
+    const __m512i p = _mm512_set1_epi32(P),  w = _mm512_set1_epi32(root),  wp = _mm512_set1_epi32(root_precomp);
+    size_t k = 0;
+    for (; k+16 <= SIZE; k+=16)
+        _mm512_storeu_si512 (dst+k, MulConst_AVX512<P> (_mm512_loadu_si512 (src+k), w, wp, p));
+    Scale_Scalar<uint32_t,P> (dst+k, src+k, SIZE-k, root, root_precomp);
+}
+
+// Order-2 NTT with twiddle factor on 16 values held in registers, employed by the radix-4/8 kernels
+template <uint32_t P>
+static inline TARGET("avx512f") void NTT2_AVX512 (__m512i& a, __m512i& b, __m512i w, __m512i w_precomp, __m512i p)
+{
+    __m512i v = MulConst_AVX512<P> (b, w, w_precomp, p);
+    b = Sub_AVX512<P> (a, v, p);
+    a = Add_AVX512<P> (a, v, p);
+}
+
+// Radix-4 kernel: 2 butterfly steps on 4 blocks, each element is loaded and stored once, and all twiddle factors are kept in registers
+template <uint32_t P>
+TARGET("avx512f") void Radix4_AVX512 (uint32_t** x, size_t SIZE, const uint32_t* root, const uint32_t* root_precomp)
+{
+    const __m512i p = _mm512_set1_epi32(P);
+    const __m512i w0 = _mm512_set1_epi32(root[0]),  w1 = _mm512_set1_epi32(root[1]),  w2 = _mm512_set1_epi32(root[2]);
+    const __m512i wp0 = _mm512_set1_epi32(root_precomp[0]),  wp1 = _mm512_set1_epi32(root_precomp[1]),  wp2 = _mm512_set1_epi32(root_precomp[2]);
+    uint32_t *x0 = x[0],  *x1 = x[1],  *x2 = x[2],  *x3 = x[3];
+    size_t k = 0;
+    for (; k+16 <= SIZE; k+=16) {
+        __m512i v0 = _mm512_loadu_si512 (x0+k),  v1 = _mm512_loadu_si512 (x1+k),  v2 = _mm512_loadu_si512 (x2+k),  v3 = _mm512_loadu_si512 (x3+k);
+        NTT2_AVX512<P> (v0, v1, w0, wp0, p);   NTT2_AVX512<P> (v2, v3, w0, wp0, p);
+        NTT2_AVX512<P> (v0, v2, w1, wp1, p);   NTT2_AVX512<P> (v1, v3, w2, wp2, p);
+        _mm512_storeu_si512 (x0+k, v0);  _mm512_storeu_si512 (x1+k, v1);
+        _mm512_storeu_si512 (x2+k, v2);  _mm512_storeu_si512 (x3+k, v3);
+    }
+    Radix_Scalar<uint32_t,P,2> (x, k, SIZE, root, root_precomp);
+}
+
+// Radix-8 kernel: 3 butterfly steps on 8 blocks
+template <uint32_t P>
+TARGET("avx512f") void Radix8_AVX512 (uint32_t** x, size_t SIZE, const uint32_t* root, const uint32_t* root_precomp)
+{
+    const __m512i p = _mm512_set1_epi32(P);
+    __m512i w[7], wp[7];
+    for (int t=0; t<7; t++)
+        w[t] = _mm512_set1_epi32(root[t]),  wp[t] = _mm512_set1_epi32(root_precomp[t]);
+    uint32_t *x0 = x[0],  *x1 = x[1],  *x2 = x[2],  *x3 = x[3],  *x4 = x[4],  *x5 = x[5],  *x6 = x[6],  *x7 = x[7];
+    size_t k = 0;
+    for (; k+16 <= SIZE; k+=16) {
+        __m512i v0 = _mm512_loadu_si512 (x0+k),  v1 = _mm512_loadu_si512 (x1+k),  v2 = _mm512_loadu_si512 (x2+k),  v3 = _mm512_loadu_si512 (x3+k);
+        __m512i v4 = _mm512_loadu_si512 (x4+k),  v5 = _mm512_loadu_si512 (x5+k),  v6 = _mm512_loadu_si512 (x6+k),  v7 = _mm512_loadu_si512 (x7+k);
+        NTT2_AVX512<P> (v0, v1, w[0], wp[0], p);   NTT2_AVX512<P> (v2, v3, w[0], wp[0], p);   NTT2_AVX512<P> (v4, v5, w[0], wp[0], p);   NTT2_AVX512<P> (v6, v7, w[0], wp[0], p);
+        NTT2_AVX512<P> (v0, v2, w[1], wp[1], p);   NTT2_AVX512<P> (v1, v3, w[2], wp[2], p);   NTT2_AVX512<P> (v4, v6, w[1], wp[1], p);   NTT2_AVX512<P> (v5, v7, w[2], wp[2], p);
+        NTT2_AVX512<P> (v0, v4, w[3], wp[3], p);   NTT2_AVX512<P> (v1, v5, w[4], wp[4], p);   NTT2_AVX512<P> (v2, v6, w[5], wp[5], p);   NTT2_AVX512<P> (v3, v7, w[6], wp[6], p);
+        _mm512_storeu_si512 (x0+k, v0);  _mm512_storeu_si512 (x1+k, v1);  _mm512_storeu_si512 (x2+k, v2);  _mm512_storeu_si512 (x3+k, v3);
+        _mm512_storeu_si512 (x4+k, v4);  _mm512_storeu_si512 (x5+k, v5);  _mm512_storeu_si512 (x6+k, v6);  _mm512_storeu_si512 (x7+k, v7);
+    }
+    Radix_Scalar<uint32_t,P,3> (x, k, SIZE, root, root_precomp);
+}
+
+// Scan and flip primitives for PackBlock/UnpackBlock
+static inline TARGET("avx512f") bool Overflow_AVX512 (const uint32_t* x, size_t n)
+{
+    const __m512i limit = _mm512_set1_epi32 (0xFFF00000);
+    __mmask16 any = 0;
+    size_t k = 0;
+    for (; k+16 <= n; k+=16)
+        any |= _mm512_cmpge_epu32_mask (_mm512_loadu_si512 (x+k), limit);
+    return any  ||  Overflow_Scalar (x+k, n-k);
+}
+
+static inline TARGET("avx512f") void Flip_AVX512 (uint32_t* x, size_t n, uint32_t mask)
+{
+    const __m512i m = _mm512_set1_epi32 (mask << 20);
+    size_t k = 0;
+    for (; k+16 <= n; k+=16)
+        _mm512_storeu_si512 (x+k, _mm512_xor_si512 (_mm512_loadu_si512 (x+k), m));
+    Flip_Scalar (x+k, n-k, mask);
+}
+
+#endif // GF_SIMD_KERNELS
+
+
+/***********************************************************************************************************************
+*** Runtime kernel selection *******************************************************************************************
+************************************************************************************************************************/
+
+enum GF_ISA {ISA_SCALAR, ISA_SSE2, ISA_AVX2, ISA_AVX512};
+static const char* GF_ISA_Names[] = {"scalar", "sse2", "avx2", "avx512"};
+
+// The best instruction set supported by both CPU and OS
+static GF_ISA GF_DetectISA()
+{
+#if defined(GF_SIMD_KERNELS) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))  return ISA_AVX512;
+    if (__builtin_cpu_supports("avx2"))     return ISA_AVX2;
+    if (__builtin_cpu_supports("sse2"))     return ISA_SSE2;
+#elif defined(GF_SIMD_KERNELS) && defined(_MSC_VER)
+    int info[4];
+    __cpuid (info, 0);
+    int max_leaf = info[0];
+    __cpuid (info, 1);
+    bool sse2 = (info[3] >> 26) & 1,  osxsave = (info[2] >> 27) & 1;
+    uint64_t xcr0 = osxsave? _xgetbv(0) : 0;
+    bool os_avx = (xcr0 & 0x06) == 0x06,  os_avx512 = (xcr0 & 0xE6) == 0xE6;
+    int ebx7 = 0;
+    if (max_leaf >= 7)  {__cpuidex (info, 7, 0);  ebx7 = info[1];}
+    if (os_avx512 && (ebx7 >> 16 & 1))  return ISA_AVX512;
+    if (os_avx    && (ebx7 >>  5 & 1))  return ISA_AVX2;
+    if (sse2)  return ISA_SSE2;
+#endif
+    return ISA_SCALAR;
+}
+
+// Selected instruction set: the best one supported, or the lower one requested by the FASTECC_SIMD environment variable
+static GF_ISA GF_SelectISA()
+{
+    GF_ISA supported = GF_DetectISA();
+    GF_ISA isa = supported;
+    const char* env = getenv("FASTECC_SIMD");
+    if (env) {
+        for (int i=ISA_SCALAR; i<=ISA_AVX512; i++)
+            if (strcmp (env, GF_ISA_Names[i]) == 0  &&  i <= supported)
+                isa = GF_ISA(i);
+    }
+    return isa;
+}
+
+
+// Kernels for P=0xFFF00001 and the ring modulo 2^32-1
+template <uint32_t P>
+struct GF_Kernels32
+{
+    typedef void ButterflyFunc  (uint32_t* a, uint32_t* b, size_t SIZE, uint32_t root, uint32_t root_precomp);
+    typedef void Butterfly1Func (uint32_t* a, uint32_t* b, size_t SIZE);
+    typedef void ScaleFunc      (uint32_t* dst, const uint32_t* src, size_t SIZE, uint32_t root, uint32_t root_precomp);
+    typedef void RadixFunc      (uint32_t** x, size_t SIZE, const uint32_t* root, const uint32_t* root_precomp);
+    typedef void PackFunc       (uint32_t* block, size_t SIZE, uint16_t* masks);
+    typedef void UnpackFunc     (uint32_t* block, size_t SIZE, const uint16_t* masks);
+
+    static constexpr bool enabled = true;
+    static GF_ISA          isa;
+    static ButterflyFunc*  Butterfly;
+    static Butterfly1Func* Butterfly1;
+    static ScaleFunc*      Scale;
+    static RadixFunc*      Radix4;
+    static RadixFunc*      Radix8;
+    static PackFunc*       Pack;
+    static UnpackFunc*     Unpack;
+
+    static const char* Name()  {return GF_ISA_Names[isa];}
+
+    static void Radix4_Scalar (uint32_t** x, size_t SIZE, const uint32_t* root, const uint32_t* root_precomp)  {Radix_Scalar<uint32_t,P,2> (x, 0, SIZE, root, root_precomp);}
+    static void Radix8_Scalar (uint32_t** x, size_t SIZE, const uint32_t* root, const uint32_t* root_precomp)  {Radix_Scalar<uint32_t,P,3> (x, 0, SIZE, root, root_precomp);}
+
+    static GF_ISA Init()
+    {
+        GF_ISA isa = GF_SelectISA();
+        switch (isa) {
+#ifdef GF_SIMD_KERNELS
+            case ISA_AVX512:  Butterfly = Butterfly_AVX512<P>;  Butterfly1 = Butterfly1_AVX512<P>;  Scale = Scale_AVX512<P>;  break;
+            case ISA_AVX2:    Butterfly = Butterfly_AVX2<P>;    Butterfly1 = Butterfly1_AVX2<P>;    Scale = Scale_AVX2<P>;    break;
+            case ISA_SSE2:    Butterfly = Butterfly_SSE2<P>;    Butterfly1 = Butterfly1_SSE2<P>;    Scale = Scale_SSE2<P>;    break;
+#endif
+            default:          Butterfly = Butterfly_Scalar<uint32_t,P>;  Butterfly1 = Butterfly1_Scalar<uint32_t,P>;  Scale = Scale_Scalar<uint32_t,P>;
+        }
+        switch (isa) {
+#ifdef GF_SIMD_KERNELS
+            case ISA_AVX512:  Radix4 = Radix4_AVX512<P>;  Radix8 = Radix8_AVX512<P>;  Pack = PackBlock<Overflow_AVX512, Flip_AVX512>;  Unpack = UnpackBlock<Flip_AVX512>;  break;
+            case ISA_AVX2:    Radix4 = Radix4_AVX2<P>;    Radix8 = Radix8_AVX2<P>;    Pack = PackBlock<Overflow_AVX2,   Flip_AVX2>;    Unpack = UnpackBlock<Flip_AVX2>;    break;
+            case ISA_SSE2:    Radix4 = Radix4_SSE2<P>;    Radix8 = Radix8_SSE2<P>;    Pack = PackBlock<Overflow_SSE2,   Flip_SSE2>;    Unpack = UnpackBlock<Flip_SSE2>;    break;
+#endif
+            default:          Radix4 = Radix4_Scalar;  Radix8 = Radix8_Scalar;  Pack = PackBlock<Overflow_Scalar, Flip_Scalar>;  Unpack = UnpackBlock<Flip_Scalar>;
+        }
+        return isa;
+    }
+};
+
+template <uint32_t P>  typename GF_Kernels32<P>::ButterflyFunc*  GF_Kernels32<P>::Butterfly;
+template <uint32_t P>  typename GF_Kernels32<P>::Butterfly1Func* GF_Kernels32<P>::Butterfly1;
+template <uint32_t P>  typename GF_Kernels32<P>::ScaleFunc*      GF_Kernels32<P>::Scale;
+template <uint32_t P>  typename GF_Kernels32<P>::RadixFunc*      GF_Kernels32<P>::Radix4;
+template <uint32_t P>  typename GF_Kernels32<P>::RadixFunc*      GF_Kernels32<P>::Radix8;
+template <uint32_t P>  typename GF_Kernels32<P>::PackFunc*       GF_Kernels32<P>::Pack;
+template <uint32_t P>  typename GF_Kernels32<P>::UnpackFunc*     GF_Kernels32<P>::Unpack;
+template <uint32_t P>  GF_ISA GF_Kernels32<P>::isa = GF_Kernels32<P>::Init();
+
+// Explicit instantiation ensures that Init() is called even by programs that don't refer to the isa
+template struct GF_Kernels32<0xFFF00001>;
+template struct GF_Kernels32<0xFFFFFFFF>;
+
+template <>  struct GF_Kernels<uint32_t,0xFFF00001> : GF_Kernels32<0xFFF00001>  {};
+template <>  struct GF_Kernels<uint32_t,0xFFFFFFFF> : GF_Kernels32<0xFFFFFFFF>  {};
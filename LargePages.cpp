@@ -68,6 +68,126 @@ void VFree( T* p )
 }
 
 
+#elif defined(__linux__)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <map>
+#include <mutex>
+
+const uint64_t g_PageMask0    = 0x1000-1;
+const uint64_t g_HugePageMask = 0x200000-1;
+bool verbose = true;
+
+void InitLargePages() {}
+
+// Number of online NUMA nodes, read from the sysfs list like "0-1"
+static int NumaNodes()
+{
+    static int nodes = []
+    {
+        int first = 0, last = 0;
+        FILE* f = fopen ("/sys/devices/system/node/online", "r");
+        if (f == 0)  return 1;
+        int n = fscanf (f, "%d-%d", &first, &last);
+        fclose (f);
+        return (n == 2?  last+1 : 1);
+    }();
+    return nodes;
+}
+
+// Transparent huge pages can be requested by madvise, unless they are disabled system-wide
+static bool TransparentHugePages()
+{
+    static bool enabled = []
+    {
+        char buf[99] = "";
+        FILE* f = fopen ("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+        if (f == 0)  return false;
+        bool ok = (fgets (buf, sizeof(buf), f) != 0  &&  strstr (buf, "[never]") == 0);
+        fclose (f);
+        return ok;
+    }();
+    return enabled;
+}
+
+// Sizes of all areas allocated by VAlloc, required by munmap
+static std::map<void*,uint64_t> g_Allocated;
+static std::mutex g_AllocatedLock;
+
+// Allocate memory with mmap, trying 2 MiB pages from the hugetlbfs pool, then transparent huge pages, then 4 KiB pages.
+// On NUMA hosts the pages are interleaved over all nodes, since blocks are processed by all threads in order determined by the work stealing.
+// Environment variables: FASTECC_HUGEPAGES=0 disables huge pages, FASTECC_NUMA=local keeps the default first-touch placement
+template< class T >
+T* VAlloc (uint64_t size)
+{
+    size *= sizeof(T);
+    const char* env_huge = getenv("FASTECC_HUGEPAGES");
+    const char* env_numa = getenv("FASTECC_NUMA");
+    bool huge = (size >= g_HugePageMask  &&  !(env_huge && strcmp (env_huge, "0") == 0));
+    uint64_t PageMask = (huge? g_HugePageMask : g_PageMask0);
+    uint64_t s = (size+PageMask) & (~PageMask);
+    if (s > size_t(-1)) {
+        return 0;
+    }
+
+    const char* pages = "4KiB pages";
+    void* r = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (huge) {
+        r = mmap (0, s, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+        if (r != MAP_FAILED)  pages = "2MiB pages";
+    }
+#endif
+    if (r == MAP_FAILED) {
+        r = mmap (0, s, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if (r == MAP_FAILED)  return 0;
+#ifdef MADV_HUGEPAGE
+        if (huge  &&  TransparentHugePages()  &&  madvise (r, s, MADV_HUGEPAGE) == 0)
+            pages = "transparent huge pages";
+#endif
+    }
+
+    // Interleave pages over NUMA nodes with mbind(MPOL_INTERLEAVE), before they are touched
+    char numa[99] = "";
+    int nodes = NumaNodes();
+#ifdef SYS_mbind
+    if (nodes > 1  &&  nodes <= 64  &&  !(env_numa && strcmp (env_numa, "local") == 0)) {
+        const int MPOL_INTERLEAVE_ = 3;
+        unsigned long nodemask = (nodes==64? ~0UL : (1UL << nodes) - 1);
+        if (syscall (SYS_mbind, r, s, MPOL_INTERLEAVE_, &nodemask, nodes+1, 0) == 0)
+            sprintf (numa, ", interleaved over %d NUMA nodes", nodes);
+    }
+#endif
+
+    {
+        std::lock_guard<std::mutex> guard (g_AllocatedLock);
+        g_Allocated[r] = s;
+    }
+    if (verbose)  printf("Allocated %.0lf MiB with %s%s\n", s/1048576.0, pages, numa);
+    return (T*)r;
+}
+
+template< class T >
+void VFree( T* p )
+{
+    if (p == 0)  return;
+    uint64_t s;
+    {
+        std::lock_guard<std::mutex> guard (g_AllocatedLock);
+        auto it = g_Allocated.find ((void*)p);
+        if (it == g_Allocated.end())  return;
+        s = it->second;
+        g_Allocated.erase (it);
+    }
+    munmap ((void*)p, s);
+}
+
+
 #else // _WIN32
 
 bool verbose = true;
@@ -87,5 +207,5 @@ void VFree( T* p )
     free(p);
 }
 
-#endif // _WIN32
+#endif // _WIN32 / __linux__
 
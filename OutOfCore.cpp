@@ -0,0 +1,218 @@
+/// Out-of-core NTT for data sets larger than RAM. Blocks are stored in files and processed by the MFA four-step algorithm,
+/// streaming column and row panels with positioned reads and writes, so only O(sqrt(N)*SIZE) bytes of RAM are required
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <string>
+
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#include <mutex>
+#else
+#include <unistd.h>
+#endif
+
+
+/***********************************************************************************************************************
+*** Block file *********************************************************************************************************
+************************************************************************************************************************/
+
+// File holding blocks of BLOCK_BYTES bytes, that are read and written by their index
+class BlockFile
+{
+    int fd;
+    uint64_t block_bytes;
+    std::string name;
+    bool remove_on_close;
+#ifdef _WIN32
+    std::mutex lock;        // serializes seek+read/write pairs
+#endif
+
+    // Read/write len bytes at the offset, return false on failure
+    bool Transfer (bool write, void* buf, uint64_t len, uint64_t offset)
+    {
+        char* ptr = (char*) buf;
+        while (len > 0) {
+            size_t chunk = size_t (std::min (len, uint64_t(1) << 30));
+#ifdef _WIN32
+            std::lock_guard<std::mutex> guard (lock);
+            if (_lseeki64 (fd, offset, SEEK_SET) < 0)  return false;
+            int done = (write?  _write (fd, ptr, unsigned(chunk))  :  _read (fd, ptr, unsigned(chunk)));
+#else
+            ssize_t done = (write?  pwrite (fd, ptr, chunk, off_t(offset))  :  pread (fd, ptr, chunk, off_t(offset)));
+#endif
+            if (done <= 0)  return false;
+            ptr += done,  len -= done,  offset += done;
+        }
+        return true;
+    }
+
+public:
+    BlockFile (uint64_t _block_bytes) : fd(-1), block_bytes(_block_bytes), remove_on_close(false)  {}
+    ~BlockFile()  {Close();}
+
+    // Open existing file (create=false) or create the new one. Temporary files are deleted by Close()
+    bool Open (const char* filename, bool create, bool temporary = false)
+    {
+        Close();
+        name = filename;
+        remove_on_close = temporary;
+#ifdef _WIN32
+        fd = _open (filename, create? _O_RDWR|_O_CREAT|_O_TRUNC|_O_BINARY : _O_RDWR|_O_BINARY,  _S_IREAD|_S_IWRITE);
+#else
+        fd = open (filename, create? O_RDWR|O_CREAT|O_TRUNC : O_RDWR,  0644);
+#endif
+        if (fd < 0)  {printf("Can't open %s\n", filename);  return false;}
+        return true;
+    }
+
+    void Close()
+    {
+        if (fd < 0)  return;
+#ifdef _WIN32
+        _close (fd);
+#else
+        close (fd);
+#endif
+        fd = -1;
+        if (remove_on_close)  remove (name.c_str());
+    }
+
+    // Read/write count blocks starting with the block first, return false on failure
+    bool Read  (uint64_t first, size_t count, void* buf)
+    {
+        if (Transfer (false, buf, count*block_bytes, first*block_bytes))  return true;
+        printf("Can't read %s\n", name.c_str());  return false;
+    }
+    bool Write (uint64_t first, size_t count, const void* buf)
+    {
+        if (Transfer (true, (void*)buf, count*block_bytes, first*block_bytes))  return true;
+        printf("Can't write %s\n", name.c_str());  return false;
+    }
+};
+
+
+/***********************************************************************************************************************
+*** Out-of-core NTT ****************************************************************************************************
+************************************************************************************************************************/
+
+// RAM budget of out-of-core algorithms, in bytes: FASTECC_MEMORY environment variable (in MiB) or 256 MiB
+inline uint64_t OutOfCoreMemory()
+{
+    const char* env = getenv("FASTECC_MEMORY");
+    return uint64_t (env && atoi(env) > 0?  atoi(env) : 256) << 20;
+}
+
+// Out-of-core NTT of order N (power of 2) on blocks of SIZE elements, stored in files.
+// Only the first NonZero input blocks are read from src[], remaining ones are zeros. Only the first Outputs results are written to dst[],
+// in the natural order. work[] is the scratch file for N blocks, that should differ from src[] and dst[], while dst[] may be the same file as src[].
+// The data are processed by the MFA algorithm with N = R*C (C = R or 2*R), input n = c + C*r, output k = k1 + R*k2:
+//   1. Columns c of R blocks are read in panels of several adjacent columns, transformed, multiplied by root(N)**(c*k1)
+//      and written to work[] as rows k1 of C blocks
+//   2. Panels of adjacent rows are read, transformed and written transposed to dst[]
+// Each panel holds at most memory bytes, but no less than one column or row, i.e. sqrt(N)*SIZE elements.
+// The results are normalized (see GF_Unnormalized) by the last step of the transform
+template <typename T, T P>
+bool FileNTT (BlockFile& src, BlockFile& dst, BlockFile& work, size_t N, size_t SIZE, bool InvNTT,
+              size_t NonZero = size_t(-1),  size_t Outputs = size_t(-1),  uint64_t memory = OutOfCoreMemory())
+{
+    NonZero = std::min (NonZero, N);
+    Outputs = std::min (Outputs, N);
+    const uint64_t BLOCK = SIZE*sizeof(T);
+    const BlockScale<T,P> normalize (0, 1, 1, BlockScale<T,P>::NORMALIZE);
+
+    // Small transforms are just performed in memory, gathering the permuted results into the second half of the buffer
+    if (2*uint64_t(N)*BLOCK <= memory) {
+        T* buf = VAlloc<T> (2*uint64_t(N)*SIZE);
+        if (buf==0)  {printf("Can't alloc %.0lf MiB of memory!\n", 2*N*BLOCK/1048576.0);  return false;}
+        std::vector<T*> data(N);
+        for (size_t i=0; i<N; i++)
+            data[i] = buf + i*SIZE;
+        bool ok = src.Read (0, NonZero, buf);
+        if (ok) {
+            NTTPlan<T,P> plan(N);
+            TransposeScratch<T,P> scratch (plan, N);
+            MFA_NTT<T,P> (data.data(), N, SIZE, InvNTT, plan, NonZero, scratch.ptr, BlockScale<T,P>(), normalize);
+            T* out = buf + N*SIZE;
+            for (size_t i=0; i<Outputs; i++)
+                memcpy (out + i*SIZE, data[i], BLOCK);
+            ok = dst.Write (0, Outputs, out);
+        }
+        VFree (buf);
+        return ok;
+    }
+
+    size_t R = size_t(1) << (int(logb(N))/2),  C = N/R;
+    size_t PC = size_t (std::max (std::min (memory / (R*BLOCK), uint64_t(C)), uint64_t(1)));     // columns per panel
+    size_t PR = size_t (std::max (std::min (memory / (C*BLOCK), uint64_t(R)), uint64_t(1)));     // rows per panel
+    size_t panel_blocks = std::max (PC*R, PR*C),  line_blocks = std::max (PC, PR);
+    T* panel = VAlloc<T> (uint64_t(panel_blocks + line_blocks) * SIZE);
+    if (panel==0)  {printf("Can't alloc %.0lf MiB of memory!\n", (panel_blocks + line_blocks)*BLOCK/1048576.0);  return false;}
+    T* line = panel + panel_blocks*SIZE;     // gathers blocks written by a single pwrite
+
+    NTTPlan<T,P> plan(C);
+    T root = GF_Root<T,P>(N);
+    if (InvNTT)  root = GF_Inv<T,P>(root);
+    std::vector<T*> ptrs (panel_blocks);
+    bool ok = true;
+
+    // 1. Column panels: NTT of order R on columns c0..c0+n-1, multiplication by root(N)**(c*k1), then store them as rows of work[]
+    for (size_t c0=0; ok && c0<C; c0+=PC) {
+        size_t n = std::min (PC, C-c0);
+        for (size_t r=0; ok && r<R; r++) {              // row r of the panel holds inputs c0+r*C .. c0+r*C+n-1
+            size_t first = c0 + r*C;
+            if (first < NonZero)
+                ok = src.Read (first, std::min (n, NonZero-first), panel + r*n*SIZE);
+        }
+        if (!ok)  break;
+        for (size_t j=0; j<n; j++)
+            for (size_t r=0; r<R; r++)
+                ptrs[j*R+r] = panel + (r*n+j)*SIZE;     // pointers to blocks of column c0+j
+        ParallelFor (0, n, [&] (ptrdiff_t j) {
+            size_t c = c0+j;
+            T** col = ptrs.data() + j*R;
+            if (c >= NonZero) {                         // column c holds inputs c, c+C, c+2*C...
+                for (size_t r=0; r<R; r++)
+                    memset (col[r], 0, BLOCK);
+                return;
+            }
+            MFA_NTT<T,P> (col, R, SIZE, InvNTT, plan, (NonZero-c+C-1)/C);
+            T root_c = GF_Pow<T,P> (root, T(c)),  root_ck = root_c;
+            for (size_t k1=1; k1<R; k1++) {
+                GF_MulConst<T,P> (col[k1], col[k1], SIZE, root_ck, GF_MulConstPrecomp<T,P> (root_ck));
+                root_ck = GF_Mul<T,P> (root_ck, root_c);
+            }
+        }, 1);
+        for (size_t k1=0; ok && k1<R; k1++) {
+            for (size_t j=0; j<n; j++)
+                memcpy (line + j*SIZE, ptrs[j*R+k1], BLOCK);
+            ok = work.Write (k1*C + c0, n, line);
+        }
+    }
+
+    // 2. Row panels: NTT of order C on rows k0..k0+n-1 of work[], storing result k1+R*k2 of the row k1 into dst[]
+    for (size_t k0=0; ok && k0<R; k0+=PR) {
+        size_t n = std::min (PR, R-k0);
+        ok = work.Read (k0*C, n*C, panel);
+        if (!ok)  break;
+        for (size_t i=0; i<n*C; i++)
+            ptrs[i] = panel + i*SIZE;
+        ParallelFor (0, n, [&] (ptrdiff_t i) {
+            TransposeScratch<T,P> scratch (plan, C);
+            MFA_NTT<T,P> (ptrs.data() + i*C, C, SIZE, InvNTT, plan, C, scratch.ptr, BlockScale<T,P>(), normalize);
+        }, 1);
+        for (size_t k2=0; ok && k2<C; k2++) {
+            size_t first = k0 + k2*R,  count = std::min (n, Outputs-std::min(first,Outputs));
+            if (count == 0)  continue;
+            for (size_t i=0; i<count; i++)
+                memcpy (line + i*SIZE, ptrs[i*C+k2], BLOCK);
+            ok = dst.Write (first, count, line);
+        }
+    }
+
+    VFree (panel);
+    return ok;
+}
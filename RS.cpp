@@ -11,77 +11,723 @@
 #include <functional>
 #include <vector>
 #include <memory>
+#include <atomic>
+#include <string>
 
 #include "wall_clock_timer.h"
 #include "LargePages.cpp"
 #include "GF(p).cpp"
+#include "GF_SIMD.cpp"
+#include "Tuning.cpp"
+#include "ThreadPool.cpp"
 #include "ntt.cpp"
+#include "OutOfCore.cpp"
 
 
-// Benchmark encoding using the Reed-Solomon algo
+/***********************************************************************************************************************
+*** Reed-Solomon encoding **********************************************************************************************
+************************************************************************************************************************/
+
+// Order of the NTT interpolating N data blocks: N rounded up to the power of 2.
+// Data blocks N..N1-1 of the code are zeros, that are never stored nor processed by the (input-pruned) iNTT
+inline size_t DataOrder (size_t N)
+{
+    size_t N1 = 1;
+    while (N1 < N)  N1 *= 2;
+    return N1;
+}
+
+// Order of the NTT computing M parity blocks for N data blocks: the smallest divisor of N that is not less than M
+inline size_t ParityOrder (size_t N, size_t M)
+{
+    size_t M1 = std::max (M, size_t(1));
+    while (N % M1)  M1++;
+    return M1;
+}
+
+
+// Encode N data blocks into M<=N1 parity blocks, where N1=DataOrder(N). Data block i is considered as value of order-N1 polynomial f(x)
+// at the point root(2*N1)**(2*i), with zero values at the points of the missing data blocks N..N1-1.
+// With M==N1, parity block i is computed as f(root(2*N1)**(2*i+1)). With smaller M, only every (N1/M1)-th of these points is computed,
+// where M1=ParityOrder(N1,M), i.e. parity block i is the parity block i*N1/M1 of the full code, and remaining ones should be considered
+// as erased by the decoder. Computation is performed in-place, i.e. on input data[0..N-1] hold the source data and on output data[0..M-1]
+// hold the parity data, while remaining blocks are trashed. data[N..N1-1] should point to the extra blocks used only as the work memory,
+// their initial contents are ignored. Note that pointers in data[] are permuted by the NTT, but data[i] always points to the i-th block.
+// The plan should support NTT of order 2*N1, and may be shared by any number of encoding operations. P should be prime:
+// in the rings modulo 2^32-1 and 2^64-1 the roots are primary only modulo some prime factors of P, so the parity can't recover the data.
+// scratch[] provides N1 pointers of work memory for the NTT transposes.
+// With masks!=NULL, data blocks hold arbitrary 32-bit words, that are packed in place into field elements by the first iNTT step
+// (see GF_PackBlock). No data words are reserved for the packing: masks[] receives GF_PackMasks(SIZE) masks per data block,
+// i.e. 2 bytes per 8 KB of data, that should be stored along with the parity and passed to the DecodeReedSolomon.
+// It's supported only in GF(0xFFF00001)
 template <typename T, T P>
-void EncodeReedSolomon (size_t N, size_t SIZE)
+void EncodeReedSolomon (T** data, size_t N, size_t SIZE, size_t M, const NTTPlan<T,P>& plan, T** scratch, uint16_t* masks = 0)
 {
-    T *data0 = VAlloc<T> (uint64_t(N)*SIZE);
-    if (data0==0)  {printf("Can't alloc %.0lf MiB of memory!\n", (N/1048576.0)*SIZE*sizeof(T)); return;}
+    size_t N1 = DataOrder (N);
+    assert (M <= N1);
 
-    for (size_t i=0; i<N*SIZE; i++)
-        data0[i] = i%P;
+    // 1. iNTT: polynomial interpolation. We find coefficients of order-N1 polynomial describing the source data.
+    // The input-pruned transform skips all computations on the zero values N..N1-1, and its first step packs the raw data.
+    // Now we should divide results by N1 in order to get coefficients, but we combined this operation with the multiplication below
+
+    // Now we can evaluate the polynomial at 2*N1 points.
+    // Points with even index will contain the source data,
+    // while points with odd indexes may be used as ECC data.
+    // But more efficient approach is to compute only odd-indexed points.
+    // This is accomplished by the following steps:
+
+    // 2. Multiply the polynomial coefficients by root(2*N1)**i. The iNTT applies these scale factors (combined with the division by N1)
+    // to its outputs in the last step, while the data are still in the cache, instead of making a separate pass over the data
+    const T* root_2N = plan.Roots(false) + 2*N1;    // root_2N[i] = root(2*N1)**i
+    T inv_N = GF_Inv<T,P>(N1);
+    MFA_NTT<T,P> (data, N1, SIZE, true, plan, N, scratch, BlockScale<T,P> (0, 1, 1, masks? BlockScale<T,P>::PACK : BlockScale<T,P>::NONE, masks),
+                                                          BlockScale<T,P> (root_2N, inv_N));
 
-    T **data = new T* [N];      // pointers to blocks
+    // Now we need to evaluate the modified polynomial g(y) at root(N1)**i points,
+    // that is equivalent to evaluation of the original polynomial at root(2*N1)**(2*i+1) points.
+    // In order to compute only M1 of them, i.e. g(y) at points y = root(M1)**i where y**M1 == 1,
+    // it's enough to evaluate g(y) mod (y**M1 - 1), i.e. fold coefficients j, j+M1, j+2*M1... together.
+
+    // 3. Fold the polynomial coefficients into M1 blocks
+    size_t M1 = ParityOrder (N1, M);
+    if (M1 < N1) {
+        ParallelFor (0, M1, [&] (ptrdiff_t j) {
+            T* __restrict__ block = data[j];
+            for (size_t q=j+M1; q<N1; q+=M1) {
+                T* __restrict__ src = data[q];
+                for (size_t k=0; k<SIZE; k++)   // cycle over SIZE elements of the single block
+                    block[k] = GF_Add<T,P> (block[k], src[k]);
+            }
+        });
+    }
+
+    // 4. NTT: polynomial evaluation at root(M1)**i points.
+    // In the fields with lazy reduction, the last NTT step also normalizes the parity blocks (see GF_Unnormalized)
+    Generic_NTT<T,P> (data, M1, SIZE, false, plan, size_t(-1), scratch, BlockScale<T,P>(), BlockScale<T,P> (0, 1, 1, BlockScale<T,P>::NORMALIZE));
+}
+
+template <typename T, T P>
+void EncodeReedSolomon (T** data, size_t N, size_t SIZE, size_t M, const NTTPlan<T,P>& plan, uint16_t* masks = 0)
+{
+    TransposeScratch<T,P> scratch (plan, DataOrder(N));
+    EncodeReedSolomon<T,P> (data, N, SIZE, M, plan, scratch.ptr, masks);
+}
+
+template <typename T, T P>
+void EncodeReedSolomon (T** data, size_t N, size_t SIZE, const NTTPlan<T,P>& plan)
+{
+    EncodeReedSolomon<T,P> (data, N, SIZE, DataOrder(N), plan);
+}
+
+template <typename T, T P>
+void EncodeReedSolomon (T** data, size_t N, size_t SIZE, size_t M)
+{
+    NTTPlan<T,P> plan(2*DataOrder(N));
+    EncodeReedSolomon<T,P> (data, N, SIZE, M, plan);
+}
+
+template <typename T, T P>
+void EncodeReedSolomon (T** data, size_t N, size_t SIZE)
+{
+    EncodeReedSolomon<T,P> (data, N, SIZE, DataOrder(N));
+}
+
+
+// Encode count independent stripes with the same geometry, sharing the plan: stripe i occupies blocks data[i*N1 .. i*N1+N1-1],
+// with the same layout as in the EncodeReedSolomon. Stripes are distributed over the threads, each stripe is encoded by a single thread
+template <typename T, T P>
+void EncodeReedSolomonBatch (T** data, size_t count, size_t N, size_t SIZE, size_t M, const NTTPlan<T,P>& plan)
+{
+    size_t N1 = DataOrder (N);
+    ParallelBatch<T> (count, N1, [&] (size_t i, T** scratch) {
+        EncodeReedSolomon<T,P> (data + i*N1, N, SIZE, M, plan, scratch);
+    });
+}
+
+
+// Out-of-core version of the EncodeReedSolomon: N data blocks are read from the data[] file, and M parity blocks are written to the parity[] file.
+// work1[] and work2[] are scratch files for N1 blocks each. At most memory bytes of RAM are used, except that each out-of-core NTT pass
+// needs at least sqrt(N1)*SIZE elements. Return false on I/O or memory allocation failure
+template <typename T, T P>
+bool EncodeReedSolomonFile (BlockFile& data, BlockFile& parity, BlockFile& work1, BlockFile& work2, size_t N, size_t SIZE, size_t M,
+                            uint64_t memory = OutOfCoreMemory())
+{
+    size_t N1 = DataOrder (N),  M1 = ParityOrder (N1, M);
+    assert (M <= N1);
+
+    // 1. iNTT: polynomial interpolation, skipping the zero values N..N1-1
+    if (!FileNTT<T,P> (data, work1, work2, N1, SIZE, true, N, N1, memory))  return false;
+
+    // 2. Multiply the polynomial coefficients by root(2*N1)**i / N1, and 3. fold them into M1 blocks.
+    // Coefficients are processed in chunks of Q blocks: chunk j0..j0+Q-1 accumulates chunks j0+t*M1 for all t, and overwrites the first of them.
+    // Since root(2*N1)**(j0+i+t*M1) == root(2*N1)**(j0+i) * root(2*N1)**(t*M1), chunk t is multiplied by the single constant root(2*N1)**(t*M1)
+    // while it's accumulated, and the sum is multiplied by the per-block factors root(2*N1)**(j0+i) / N1, computed once per chunk,
+    // together with the last addition
+    const uint64_t BLOCK = SIZE*sizeof(T);
+    size_t Q = size_t (std::max (std::min (memory / (2*BLOCK), uint64_t(M1)), uint64_t(1)));
+    T* acc = VAlloc<T> (2*uint64_t(Q)*SIZE);
+    if (acc==0)  {printf("Can't alloc %.0lf MiB of memory!\n", 2*Q*BLOCK/1048576.0);  return false;}
+    T* tmp = acc + Q*SIZE;
+    T root_2N = GF_Root<T,P> (2*N1),  inv_N = GF_Inv<T,P> (N1),  root_M1 = GF_Pow<T,P> (root_2N, T(M1));
+    std::vector<T> scale (Q),  scale_precomp (Q);
+    bool ok = true;
+    for (size_t j0=0; ok && j0<M1; j0+=Q) {
+        size_t n = std::min (Q, M1-j0);
+        T root_i = GF_Mul<T,P> (inv_N, GF_Pow<T,P> (root_2N, T(j0)));
+        for (size_t i=0; i<n; i++) {
+            scale[i] = root_i,  scale_precomp[i] = GF_MulConstPrecomp<T,P> (root_i);
+            root_i = GF_Mul<T,P> (root_i, root_2N);
+        }
+        T w = 1;     // root(2*N1)**(q-j0)
+        for (size_t q=j0; ok && q<N1; q+=M1, w=GF_Mul<T,P> (w, root_M1)) {
+            T* buf = (q==j0? acc : tmp);
+            if (!(ok = work1.Read (q, n, buf)))  break;
+            T w_precomp = GF_MulConstPrecomp<T,P> (w);
+            bool last = (q+M1 >= N1);
+            ParallelFor (0, n, [&] (ptrdiff_t i) {
+                T* __restrict__ block = acc + i*SIZE;
+                T* __restrict__ src   = buf + i*SIZE;
+                if (buf != acc) {
+                    GF_MulConst<T,P> (src, src, SIZE, w, w_precomp);
+                    for (size_t k=0; k<SIZE; k++)   // cycle over SIZE elements of the single block
+                        block[k] = GF_Add<T,P> (block[k], src[k]);
+                }
+                if (last)
+                    GF_MulConst<T,P> (block, block, SIZE, scale[i], scale_precomp[i]);
+            });
+        }
+        if (ok)  ok = work1.Write (j0, n, acc);
+    }
+    VFree (acc);
+
+    // 4. NTT: polynomial evaluation at root(M1)**i points, writing only the first M of them
+    return ok  &&  FileNTT<T,P> (work1, parity, work2, M1, SIZE, false, M1, M, memory);
+}
+
+
+/***********************************************************************************************************************
+*** Operations on scalar polynomials ***********************************************************************************
+************************************************************************************************************************/
+
+// Product of two polynomials given by their coefficients
+template <typename T, T P>
+std::vector<T> PolyMul (const std::vector<T>& a, const std::vector<T>& b, const NTTPlan<T,P>& plan)
+{
+    size_t n = a.size()+b.size()-1;
+    std::vector<T> res(n, 0);
+
+    // Small polynomials are multiplied by definition
+    if (std::min(a.size(),b.size()) <= 32) {
+        for (size_t i=0; i<a.size(); i++)
+            for (size_t j=0; j<b.size(); j++)
+                res[i+j] = GF_Add<T,P> (res[i+j], GF_Mul<T,P> (a[i], b[j]));
+        return res;
+    }
+
+    // Larger ones - by multiplication in the value space
+    size_t N = 1;   while (N < n)  N*=2;
+    std::vector<T> fa(a), fb(b);
+    fa.resize(N,0),  fb.resize(N,0);
+    ScalarNTT<T,P> (fa.data(), N, false, plan);
+    ScalarNTT<T,P> (fb.data(), N, false, plan);
     for (size_t i=0; i<N; i++)
+        fa[i] = GF_Mul<T,P> (fa[i], fb[i]);
+    ScalarNTT<T,P> (fa.data(), N, true, plan);
+
+    T inv_N = GF_Inv<T,P>(N);
+    for (size_t i=0; i<n; i++)
+        res[i] = GF_Mul<T,P> (fa[i], inv_N);
+    return res;
+}
+
+
+// Coefficients of the polynomial (x-roots[0])*...*(x-roots[M-1]), computed by the product tree in O(M*log(M)^2) time
+template <typename T, T P>
+std::vector<T> PolyFromRoots (const T* roots, size_t M, const NTTPlan<T,P>& plan)
+{
+    if (M <= 32) {
+        std::vector<T> res(1, 1);
+        for (size_t i=0; i<M; i++) {
+            res.push_back(0);
+            for (size_t j=res.size()-1; j>0; j--)   // res *= (x-roots[i])
+                res[j] = GF_Sub<T,P> (res[j-1], GF_Mul<T,P> (res[j], roots[i]));
+            res[0] = GF_Sub<T,P> (0, GF_Mul<T,P> (res[0], roots[i]));
+        }
+        return res;
+    }
+    // Large halves are built as tasks, so idle threads can steal them
+    std::vector<T> a, b;
+    TaskGroup tasks;
+    if (M > 4096)  tasks.Run ([&]{a = PolyFromRoots<T,P> (roots, M/2, plan);});
+    else           a = PolyFromRoots<T,P> (roots, M/2, plan);
+    b = PolyFromRoots<T,P> (roots+M/2, M-M/2, plan);
+    tasks.Wait();
+    return PolyMul<T,P> (a, b, plan);
+}
+
+
+/***********************************************************************************************************************
+*** Reed-Solomon decoding **********************************************************************************************
+************************************************************************************************************************/
+
+// Recover erased blocks of the code produced by EncodeReedSolomon, employing the formal derivative algorithm described in README.md.
+// data[0..N-1] and parity[0..N1-1] point to the data and parity blocks, where N1=DataOrder(N), erasures[0..M-1] lists indexes
+// of lost blocks, where index i<N means data[i] and index N+i means parity[i]. Lost blocks are overwritten with recovered contents,
+// remaining blocks are kept intact. Lost blocks having NULL pointers in data[] or parity[] aren't recovered, f.e. it's the case
+// for parity blocks that weren't computed by the encoder with M<N1. Return false if the data can't be recovered (i.e. M>N1).
+// The plan should support NTT of order 2*N1, the same plan may be used for encoding. work[] provides 2*N1 blocks of work memory,
+// that may be reused by any number of decoding operations, so the decoder neither allocates nor faults in fresh memory on each call.
+// With masks!=NULL, data blocks hold raw words and masks[] holds the masks returned by the EncodeReedSolomon: the surviving blocks
+// are packed with their known masks while they are loaded, and the recovered ones are unpacked
+template <typename T, T P>
+bool DecodeReedSolomon (T** data, T** parity, size_t N, size_t SIZE, const size_t* erasures, size_t M, const NTTPlan<T,P>& plan, T** work,
+                        const uint16_t* masks = 0)
+{
+    size_t N1 = DataOrder (N);
+    if (M == 0)  return true;
+    if (M > N1)  {printf("Can't recover %.0lf blocks using only %.0lf remaining ones!\n", M*1.0, (2*N1-M)*1.0); return false;}
+
+    // Codeword positions: data block i is the value at the point root(2*N1)**(2*i), parity block i - at the point root(2*N1)**(2*i+1).
+    // Data blocks N..N1-1 are known to be zeros
+    const T* root_2N = plan.Roots(false) + 2*N1;    // root_2N[i] = root(2*N1)**i
+    std::vector<bool> erased(2*N1, false);
+    std::vector<T> points(M);
+    bool LostData = false,  LostParity = false;
+    for (size_t i=0; i<M; i++) {
+        size_t pos = (erasures[i] < N?  2*erasures[i] : 2*(erasures[i]-N)+1);
+        erased[pos] = true;
+        points[i] = root_2N[pos];
+        if (erasures[i] < N?  data[erasures[i]] : parity[erasures[i]-N])
+            (erasures[i] < N?  LostData : LostParity) = true;
+    }
+
+    // 1. Build the erasure locator polynomial l(x) = (x-e[1])*...*(x-e[M]), and compute values of l(x) and l'(x) at all 2*N1 points
+    std::vector<T> l = PolyFromRoots<T,P> (points.data(), M, plan),  dl(2*N1, 0);
+    for (size_t j=1; j<l.size(); j++)
+        dl[j-1] = GF_Mul<T,P> (l[j], T(j));       // formal derivative
+    l.resize(2*N1, 0);
+    ScalarNTT<T,P> (l.data(),  2*N1, false, plan);
+    ScalarNTT<T,P> (dl.data(), 2*N1, false, plan);
+
+    std::vector<T*> p (work, work + 2*N1);    // pointers to work blocks, permuted by the NTTs
+
+    // 2. Values of the polynomial p(x) = f(x)*l(x) at all 2*N1 points, p(e[i]) == 0
+    ParallelFor (0, 2*N1, [&] (ptrdiff_t j) {
+        T* __restrict__ block = p[j];
+        if (erased[j]  ||  (j%2==0 && size_t(j/2)>=N)) {
+            memset (block, 0, SIZE*sizeof(T));
+            return;
+        }
+        T* __restrict__ src = (j%2? parity[j/2] : data[j/2]);
+        if (masks  &&  j%2==0) {
+            memcpy (block, src, SIZE*sizeof(T));
+            GF_UnpackBlock<T,P> (block, SIZE, masks + j/2*GF_PackMasks(SIZE));   // packing with known masks is the same XOR
+            src = block;
+        }
+        GF_MulConst<T,P> (block, src, SIZE, l[j], GF_MulConstPrecomp<T,P> (l[j]));
+    });
+
+    // 3. iNTT: polynomial interpolation. Now p[j] holds coefficient j of p(x), multiplied by 2*N1.
+    // Its last step also multiplies coefficient j by j, that is the first half of the formal derivative computation
+    std::vector<T> index(2*N1);
+    for (size_t j=0; j<2*N1; j++)
+        index[j] = T(j);
+    TransposeScratch<T,P> scratch (plan, 2*N1);
+    MFA_NTT<T,P> (p.data(), 2*N1, SIZE, true, plan, size_t(-1), scratch.ptr, BlockScale<T,P>(), BlockScale<T,P> (index.data()));
+
+    // 4. Formal derivative: coefficient j of p'(x) is (j+1)*p[j+1], so dp[j] is just the scaled p[j+1].
+    // p[0] was multiplied by 0, so we reuse its block to hold the last coefficient, that is zero.
+    std::vector<T*> dp(2*N1);
+    for (size_t j=0; j<2*N1-1; j++)
+        dp[j] = p[j+1];
+    dp[2*N1-1] = p[0];
+
+    // Now we need values of p'(x) at the erased points. As in the EncodeReedSolomon, we compute only
+    // the N1 even or N1 odd points, using one radix-2 step of the decimation-in-frequency NTT:
+    // dp[j] := dp[j]+dp[j+N1] (values at even points) and dp[j+N1] := (dp[j]-dp[j+N1]) * root_2N**j (values at odd points).
+    // Multiplication by root_2N**j is performed by the first step of the odd points NTT
+    ParallelFor (0, N1, [&] (ptrdiff_t j) {
+        NTT2<T,P> (dp[j], dp[j+N1], SIZE);
+    });
+
+    // 5. NTT: polynomial evaluation at the even points (data blocks) and/or odd points (parity blocks)
+    if (LostData)    MFA_NTT<T,P> (dp.data(),    N1, SIZE, false, plan, size_t(-1), scratch.ptr);
+    if (LostParity)  MFA_NTT<T,P> (dp.data()+N1, N1, SIZE, false, plan, size_t(-1), scratch.ptr, BlockScale<T,P> (root_2N));
+
+    // 6. Recover lost blocks: f(e[i]) = p'(e[i]) / l'(e[i]), dividing also by 2*N1, the scale of the iNTT result
+    ParallelFor (0, M, [&] (ptrdiff_t i) {
+        size_t pos = (erasures[i] < N?  2*erasures[i] : 2*(erasures[i]-N)+1);
+        T* __restrict__ block = (pos%2?  dp[N1+pos/2] : dp[pos/2]);
+        T* __restrict__ dst   = (pos%2?  parity[pos/2] : data[pos/2]);
+        if (!dst)  return;
+        T mul = GF_Inv<T,P> (GF_Mul<T,P> (dl[pos], T(2*N1)));
+        GF_MulConst<T,P> (dst, block, SIZE, mul, GF_MulConstPrecomp<T,P> (mul));
+        if (masks  &&  pos%2==0)
+            GF_UnpackBlock<T,P> (dst, SIZE, masks + pos/2*GF_PackMasks(SIZE));
+    });
+
+    return true;
+}
+
+template <typename T, T P>
+bool DecodeReedSolomon (T** data, T** parity, size_t N, size_t SIZE, const size_t* erasures, size_t M, const NTTPlan<T,P>& plan, const uint16_t* masks = 0)
+{
+    size_t N1 = DataOrder (N);
+    T *work0 = VAlloc<T> (uint64_t(2*N1)*SIZE);
+    if (work0==0)  {printf("Can't alloc %.0lf MiB of memory!\n", (2*N1/1048576.0)*SIZE*sizeof(T)); return false;}
+    std::vector<T*> work(2*N1);
+    for (size_t i=0; i<2*N1; i++)
+        work[i] = work0 + i*SIZE;
+    bool ok = DecodeReedSolomon<T,P> (data, parity, N, SIZE, erasures, M, plan, work.data(), masks);
+    VFree (work0);
+    return ok;
+}
+
+template <typename T, T P>
+bool DecodeReedSolomon (T** data, T** parity, size_t N, size_t SIZE, const size_t* erasures, size_t M, const uint16_t* masks = 0)
+{
+    NTTPlan<T,P> plan(2*DataOrder(N));
+    return DecodeReedSolomon<T,P> (data, parity, N, SIZE, erasures, M, plan, masks);
+}
+
+
+/***********************************************************************************************************************
+*** Benchmarks *********************************************************************************************************
+************************************************************************************************************************/
+
+// Return hash of the data
+template <typename T>
+uint32_t hash (T** data, size_t N, size_t SIZE)
+{
+    uint32_t hash = 314159253;
+    for (size_t i=0; i<N; i++) {
+        uint32_t* ptr = (uint32_t*) data[i];
+        for (size_t k=0; k<SIZE*sizeof(T)/sizeof(uint32_t); k++)
+            hash = (hash+ptr[k])*123456791 + (hash>>17);
+    }
+    return hash;
+}
+
+
+// Number of blocks as printed by benchmarks
+static std::string BlocksStr (size_t N)
+{
+    char buf[99];
+    if (N & (N-1))  sprintf (buf, "%.0lf", N*1.0);
+    else            sprintf (buf, "2^%.0lf", logb(N));
+    return buf;
+}
+
+
+// Fill N source blocks stored sequentially: element i is i%P, or with raw==true, the random 32-bit word
+template <typename T, T P>
+void FillSourceData (T* data, size_t N, size_t SIZE, bool raw)
+{
+    uint64_t rnd = 0x9E3779B97F4A7C15;
+    for (size_t i=0; i<N*SIZE; i++) {
+        rnd = rnd*6364136223846793005 + 1442695040888963407;
+        data[i] = (raw?  T(rnd>>32) : T(i%P));
+    }
+}
+
+
+// Benchmark encoding using the Reed-Solomon algo
+template <typename T, T P>
+void BenchEncode (size_t N, size_t SIZE, size_t M, bool raw)
+{
+    size_t N1 = DataOrder (N);  // source blocks + work memory
+    T *data0 = VAlloc<T> (uint64_t(N1)*SIZE);
+    if (data0==0)  {printf("Can't alloc %.0lf MiB of memory!\n", (N1/1048576.0)*SIZE*sizeof(T)); return;}
+
+    FillSourceData<T,P> (data0, N, SIZE, raw);
+
+    T **data = new T* [N1];     // pointers to blocks
+    for (size_t i=0; i<N1; i++)
         data[i] = data0 + i*SIZE;
+    std::vector<uint16_t> masks (raw? N*GF_PackMasks(SIZE) : 0);
+
+    NTTPlan<T,P> plan(2*N1, BenchKernel());    // created once per geometry
 
     char title[999];
-    sprintf (title, "Reed-Solomon encoding (2^%.0lf source blocks => 2^%.0lf ECC blocks, %.0lf bytes each)", logb(N), logb(N), SIZE*1.0*sizeof(T));
+    sprintf (title, "Reed-Solomon encoding (%s source blocks => %s ECC blocks, %.0lf bytes each)", BlocksStr(N).c_str(), BlocksStr(M).c_str(), SIZE*1.0*sizeof(T));
 
-    time_it (2.0*N*SIZE*sizeof(T), title, [&]
+    time_it (1.0*(N+M)*SIZE*sizeof(T), title, [&]
     {
-        // 1. iNTT: polynomial interpolation. We find coefficients of order-N polynomial describing the source data
-        MFA_NTT<T,P> (data, N, SIZE, true);
-        // Now we should divide results by N in order to get coefficients, but we combined this operation with the multiplication below
-
-        // Now we can evaluate the polynomial at 2*N points.
-        // Points with even index will contain the source data,
-        // while points with odd indexes may be used as ECC data.
-        // But more efficient approach is to compute only odd-indexed points.
-        // This is accomplished by the following steps:
-
-        // 2. Multiply the polynomial coefficients by root(2*N)**i
-        T root_2N = GF_Root<T,P>(2*N),  inv_N = GF_Inv<T,P>(N);
-        #pragma omp parallel for
-        for (ptrdiff_t i=0; i<N; i++) {
-            T root_i = GF_Mul<T,P> (inv_N, GF_Pow<T,P>(root_2N,i));    // root_2N**i / N (combine division by N with multiplication by powers of the root)
-            T* __restrict__ block = data[i];
-            for (size_t k=0; k<SIZE; k++) {         // cycle over SIZE elements of the single block
-                block[k] = GF_Mul<T,P> (block[k], root_i);
+        EncodeReedSolomon<T,P> (data, N, SIZE, M, plan, raw? masks.data() : 0);
+    });
+}
+
+
+// Benchmark encoding of many independent stripes, ~256 MiB of source data overall: first encoded one at a time, then by the EncodeReedSolomonBatch
+// distributing them over the threads. Parity blocks computed by both runs should be the same
+template <typename T, T P>
+void BenchEncodeBatch (size_t N, size_t SIZE, size_t M)
+{
+    size_t N1 = DataOrder (N);
+    size_t COUNT = std::max ((size_t(256) << 20) / (N*SIZE*sizeof(T)), size_t(1));
+    T *data0 = VAlloc<T> (uint64_t(COUNT)*N1*SIZE);
+    if (data0==0)  {printf("Can't alloc %.0lf MiB of memory!\n", (COUNT*N1/1048576.0)*SIZE*sizeof(T)); return;}
+
+    T **data = new T* [COUNT*N1];   // pointers to blocks, stripe i uses data[i*N1..i*N1+N1-1]
+    auto init = [&]
+    {
+        for (size_t i=0; i<COUNT; i++)
+            for (size_t j=0; j<N1; j++) {
+                data[i*N1+j] = data0 + (i*N1+j)*SIZE;
+                for (size_t k=0; k<SIZE; k++)
+                    data[i*N1+j][k] = (j<N?  ((i*N+j)*SIZE+k) % P : 0);
             }
+    };
+    auto parity_hash = [&]
+    {
+        uint32_t h = 0;
+        for (size_t i=0; i<COUNT; i++)
+            h = h*31 + hash(data+i*N1, M, SIZE);
+        return h;
+    };
+
+    NTTPlan<T,P> plan(2*N1, BenchKernel());    // shared by all stripes
+    char title[999];
+
+    init();
+    sprintf (title, "Reed-Solomon encoding of %.0lf stripes one at a time (%s source blocks => %s ECC blocks, %.0lf bytes each)",
+             COUNT*1.0, BlocksStr(N).c_str(), BlocksStr(M).c_str(), SIZE*1.0*sizeof(T));
+    time_it (1.0*COUNT*(N+M)*SIZE*sizeof(T), title, [&]{for (size_t i=0; i<COUNT; i++)  EncodeReedSolomon<T,P> (data+i*N1, N, SIZE, M, plan);});
+    uint32_t hash1 = parity_hash();
+
+    init();
+    sprintf (title, "Reed-Solomon encoding of %.0lf stripes in batch (%s source blocks => %s ECC blocks, %.0lf bytes each)",
+             COUNT*1.0, BlocksStr(N).c_str(), BlocksStr(M).c_str(), SIZE*1.0*sizeof(T));
+    time_it (1.0*COUNT*(N+M)*SIZE*sizeof(T), title, [&]{EncodeReedSolomonBatch<T,P> (data, COUNT, N, SIZE, M, plan);});
+    uint32_t hash2 = parity_hash();
+
+    if (hash1==hash2) {
+        if (verbose)  printf("Verified!\n");
+    } else {
+        printf("Batch mismatch: one at a time %.0lf,  batch %.0lf\n", double(hash1), double(hash2));
+    }
+    delete[] data;
+    VFree (data0);
+}
+
+
+// Benchmark out-of-core encoding: N data blocks are written to the temporary file, encoded into the parity file,
+// and the parity is compared to results of the in-memory encoding when the data are small enough
+template <typename T, T P>
+void BenchEncodeFile (size_t N, size_t SIZE, size_t M)
+{
+    const uint64_t BLOCK = SIZE*sizeof(T);
+    BlockFile data(BLOCK), parity(BLOCK), work1(BLOCK), work2(BLOCK);
+    if (!data.Open ("fastecc-data.tmp", true, true)  ||  !parity.Open ("fastecc-parity.tmp", true, true)  ||
+        !work1.Open ("fastecc-work1.tmp", true, true)  ||  !work2.Open ("fastecc-work2.tmp", true, true))  return;
+
+    // Fill the data file with the same contents as BenchEncode, 1024 blocks at a time
+    const size_t CHUNK = 1024;
+    std::vector<T> buf (CHUNK*SIZE);
+    for (size_t i=0; i<N; i+=CHUNK) {
+        size_t n = std::min (CHUNK, N-i);
+        for (size_t k=0; k<n*SIZE; k++)
+            buf[k] = (i*SIZE+k) % P;
+        if (!data.Write (i, n, buf.data()))  return;
+    }
+
+    char title[999];
+    sprintf (title, "Out-of-core Reed-Solomon encoding (%s source blocks => %s ECC blocks, %.0lf bytes each, %.0lf MiB RAM)",
+             BlocksStr(N).c_str(), BlocksStr(M).c_str(), BLOCK*1.0, OutOfCoreMemory()/1048576.0);
+
+    bool ok;
+    time_it (1.0*(N+M)*BLOCK, title, [&]
+    {
+        ok = EncodeReedSolomonFile<T,P> (data, parity, work1, work2, N, SIZE, M);
+    });
+    if (!ok)  return;
+
+    // Verify against the in-memory encoder, if it needs no more than 1 GiB
+    size_t N1 = DataOrder (N);
+    if (uint64_t(N1)*BLOCK > (uint64_t(1) << 30))  return;
+    T *data0 = VAlloc<T> (uint64_t(N1+M)*SIZE);
+    if (data0==0)  return;
+    T **blocks = new T* [N1];
+    for (size_t i=0; i<N1; i++)
+        blocks[i] = data0 + i*SIZE;
+    for (size_t i=0; i<N*SIZE; i++)
+        data0[i] = i%P;
+    EncodeReedSolomon<T,P> (blocks, N, SIZE, M);
+
+    T *parity0 = data0 + N1*SIZE;
+    std::vector<T*> computed (M);
+    for (size_t i=0; i<M; i++)
+        computed[i] = parity0 + i*SIZE;
+    if (parity.Read (0, M, parity0)) {
+        if (hash(blocks, M, SIZE) == hash(computed.data(), M, SIZE)) {
+            if (verbose)  printf("Verified!\n");
+        } else {
+            printf("Parity mismatch with the in-memory encoder!\n");
         }
+    }
+    delete[] blocks;
+    VFree (data0);
+}
+
+
+// Benchmark decoding using the Reed-Solomon algo: encode N data blocks into M parity ones,
+// lose M random blocks out of them and recover them. The decoder work memory is allocated and touched prior to the measurement
+template <typename T, T P>
+void BenchDecode (size_t N, size_t SIZE, size_t M, bool raw)
+{
+    size_t N1 = DataOrder (N);
+    T *data0 = VAlloc<T> (uint64_t(N+3*N1)*SIZE);
+    if (data0==0)  {printf("Can't alloc %.0lf MiB of memory!\n", ((N+3*N1)/1048576.0)*SIZE*sizeof(T)); return;}
+
+    FillSourceData<T,P> (data0, N, SIZE, raw);
+    memcpy (data0 + N*SIZE, data0, N*SIZE*sizeof(T));
+
+    T **data   = new T* [N];    // pointers to data blocks
+    T **parity = new T* [N1];   // pointers to parity blocks
+    for (size_t i=0; i<N; i++)
+        data[i]   = data0 + i*SIZE;
+    for (size_t i=0; i<N1; i++)
+        parity[i] = data0 + (N+i)*SIZE;
+    std::vector<T*> work (2*N1);  // work memory of the decoder
+    for (size_t i=0; i<2*N1; i++)
+        work[i] = data0 + (N+N1+i)*SIZE;
+    memset (work[0], 0, 2*N1*SIZE*sizeof(T));
+    std::vector<uint16_t> masks (raw? N*GF_PackMasks(SIZE) : 0);   // stored along with the parity
+
+    NTTPlan<T,P> plan(2*N1, BenchKernel());    // shared by the encoder and decoder
+    EncodeReedSolomon<T,P> (parity, N, SIZE, M, plan, raw? masks.data() : 0);
+
+    // Computed parity blocks are parity blocks i*N1/M1 of the full code, the remaining ones are lost from the start
+    size_t step = N1 / ParityOrder (N1, M);
+    std::vector<T*> computed (parity, parity+M);
+    std::vector<size_t> erasures;
+    for (size_t i=0; i<N1; i++)
+        parity[i] = 0;
+    for (size_t i=0; i<M; i++)
+        parity[i*step] = computed[i];
+    for (size_t i=0; i<N1; i++)
+        if (!parity[i])  erasures.push_back(N+i);
+    uint32_t hash_data = hash(data, N, SIZE),  hash_parity = hash(computed.data(), M, SIZE);
 
-        // 3. NTT: polynomial evaluation. This evaluates the modified polynomial at root(N)**i points,
-        // that is equivalent to evaluation of the original polynomial at root(2*N)**(2*i+1) points.
-        MFA_NTT<T,P> (data, N, SIZE, false);
+    // Choose M random blocks to lose and trash their contents
+    std::vector<size_t> blocks;
+    for (size_t i=0; i<N; i++)
+        blocks.push_back(i);
+    for (size_t i=0; i<M; i++)
+        blocks.push_back(N+i*step);
+    uint64_t rnd = 0x9E3779B97F4A7C15;
+    for (size_t i=N+M-1; i>0; i--) {
+        rnd = rnd*6364136223846793005 + 1442695040888963407;
+        std::swap (blocks[i], blocks[(rnd>>33) % (i+1)]);
+    }
+    for (size_t i=0; i<M; i++) {
+        erasures.push_back(blocks[i]);
+        memset (blocks[i]<N? data[blocks[i]] : parity[blocks[i]-N],  0x55, SIZE*sizeof(T));
+    }
 
-        // Further optimization: in order to compute only even-indexed points,
-        // it's enough to compute order-N/2 NTT of data[i]+data[i+N/2]. And so on...
+    char title[999];
+    sprintf (title, "Reed-Solomon decoding (%s source + %s ECC blocks, %.0lf lost, %.0lf bytes each)", BlocksStr(N).c_str(), BlocksStr(M).c_str(), M*1.0, SIZE*1.0*sizeof(T));
+
+    time_it (1.0*(N+M)*SIZE*sizeof(T), title, [&]
+    {
+        DecodeReedSolomon<T,P> (data, parity, N, SIZE, erasures.data(), erasures.size(), plan, work.data(), raw? masks.data() : 0);
     });
+
+    if (hash(data, N, SIZE) == hash_data  &&  hash(computed.data(), M, SIZE) == hash_parity) {
+        if (verbose)  printf("Verified!\n");
+    } else {
+        printf("Recovered data mismatch!\n");
+    }
+    delete[] data;
+    delete[] parity;
+    VFree (data0);
+}
+
+
+// Run the benchmark selected by the cmdline, in the GF(P)
+template <typename T, T P>
+void Bench (bool decode, bool file, bool batch, bool raw, size_t N, size_t SIZE, size_t M)
+{
+    // Both the encoder and decoder need NTT of order 2*N1
+    size_t N1 = DataOrder(N);
+    if (GF_GroupOrder<T,P>() % (2*N1))          {printf("NTT of order %.0lf isn't supported modulo %.0lf\n", 2.0*N1, double(P));  return;}
+    if (raw  &&  (file || batch || !GF_Packable<T,P>()))     {printf("Raw data are supported only by in-memory encoding and decoding in GF(0xFFF00001)\n");  return;}
+
+    if (verbose)  printf("GF kernels: %s, L2 cache per thread: %.0lf KB\nThread pool: %s\n", GF_Kernels<T,P>::Name(), L2Cache()/1024.0, ThreadPool::Instance().Description().c_str());
+    if (batch)
+        BenchEncodeBatch<T,P> (N,SIZE/sizeof(T),M);
+    else if (file)
+        BenchEncodeFile<T,P> (N,SIZE/sizeof(T),M);
+    else if (decode)
+        BenchDecode<T,P> (N,SIZE/sizeof(T),M,raw);
+    else
+        BenchEncode<T,P> (N,SIZE/sizeof(T),M,raw);
 }
 
 
+// Parse cmdline:
+//   RS [.][^][d|b|f][r] [N=19 [SIZE=2052 [M=N1]]]
+//   '.': quiet mode (on success, print only benchmark results)
+//   '^': compute in GF(2^64-2^32+1) instead of GF(0xFFF00001)
+//   'd': benchmark decoding instead of encoding
+//   'b': benchmark encoding of many independent stripes, ~256 MiB of source data overall
+//   'f': benchmark out-of-core encoding, using temporary files in the current directory and FASTECC_MEMORY MiB of RAM (256 by default)
+//   'r': encode/decode random raw data, packed into GF(0xFFF00001) elements on the fly (with 2 bytes of masks per 8 KB of data stored separately)
+//   N:   log2 of the number of source blocks, or the number itself if it's larger than 32
+//   M:   number of parity blocks, up to N1 = N rounded up to the power of 2
 int main (int argc, char **argv)
 {
     size_t N = 1<<19;   // NTT order
     size_t SIZE = 2052; // Block size, in bytes
                         // 1 GB total
+    bool decode = false,  file = false,  batch = false,  raw = false;
+    char field = 0;
 
     if (argc>=2 && argv[1][0]=='.') {
         argv[1]++;
         verbose = false;
         if (argv[1][0]==0)  argv++, argc--;
     }
-    if (argc>=2)  N = 1<<atoi(argv[1]);
+    if (argc>=2 && argv[1][0]=='^') {
+        field = argv[1][0];
+        argv[1]++;
+        if (argv[1][0]==0)  argv++, argc--;
+    }
+    if (argc>=2 && argv[1][0]=='d') {
+        argv[1]++;
+        decode = true;
+        if (argv[1][0]==0)  argv++, argc--;
+    }
+    if (argc>=2 && argv[1][0]=='b') {
+        argv[1]++;
+        batch = true;
+        if (argv[1][0]==0)  argv++, argc--;
+    }
+    if (argc>=2 && argv[1][0]=='f') {
+        argv[1]++;
+        file = true;
+        if (argv[1][0]==0)  argv++, argc--;
+    }
+    if (argc>=2 && argv[1][0]=='r') {
+        argv[1]++;
+        raw = true;
+        if (argv[1][0]==0)  argv++, argc--;
+    }
+    if (argc>=2)  N = atoi(argv[1]),  N = (N>32? N : size_t(1)<<N);
     if (argc>=3)  SIZE = atoi(argv[2]);
+    size_t N1 = DataOrder(N);
+    size_t M = (argc>=4? atoi(argv[3]) : N1);
+    if (M<1 || M>N1)  {printf("Number of parity blocks should be in the 1..%.0lf range\n", N1*1.0);  return 1;}
 
     // InitLargePages();
-    EncodeReedSolomon<uint32_t,0xFFF00001> (N,SIZE/sizeof(uint32_t));
+    LoadWisdom();
+    if (field=='^') {
+#ifdef MY_CPU_64BIT
+        Bench<uint64_t,0xFFFFFFFF00000001> (decode, file, batch, raw, N, SIZE, M);
+#else
+        printf("Computations modulo 2^64-2^32+1 are supported only in 64-bit program versions\n");
+#endif
+    } else {
+        Bench<uint32_t,0xFFF00001> (decode, file, batch, raw, N, SIZE, M);
+    }
 }
@@ -0,0 +1,312 @@
+/// Persistent work-stealing thread pool, employed by all parallel stages of NTT and Reed-Solomon algorithms.
+/// Each worker owns a task deque: it pushes and pops tasks at the back, while idle workers steal from the front of other deques.
+/// Threads waiting for their tasks execute other ones meanwhile, so nested parallel loops (f.e. sub-transforms of MFA_NTT)
+/// become stealable tasks instead of nested parallel regions.
+
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+
+/***********************************************************************************************************************
+*** CPU affinity *******************************************************************************************************
+************************************************************************************************************************/
+
+// CPUs available to the process
+static std::vector<int> ProcessCPUs()
+{
+    std::vector<int> cpus;
+#if defined(__linux__)
+    cpu_set_t set;
+    if (sched_getaffinity (0, sizeof(set), &set) == 0)
+        for (int i=0; i<CPU_SETSIZE; i++)
+            if (CPU_ISSET (i, &set))  cpus.push_back(i);
+#elif defined(_WIN32)
+    DWORD_PTR process_mask, system_mask;
+    if (GetProcessAffinityMask (GetCurrentProcess(), &process_mask, &system_mask))
+        for (int i=0; i<int(8*sizeof(process_mask)); i++)
+            if ((process_mask >> i) & 1)  cpus.push_back(i);
+#endif
+    if (cpus.empty())
+        for (int i=0; i<int(std::max (std::thread::hardware_concurrency(), 1u)); i++)
+            cpus.push_back(i);
+    return cpus;
+}
+
+// Parse CPU list like "0-15,32-47"
+static std::vector<int> ParseCPUs (const char* list)
+{
+    std::vector<int> cpus;
+    while (*list) {
+        char* end;
+        long first = strtol (list, &end, 10),  last = first;
+        if (end == list)  break;
+        if (*end == '-')  last = strtol (end+1, &end, 10);
+        for (long i=first; i<=last; i++)
+            cpus.push_back(int(i));
+        list = end + (*end == ',');
+    }
+    return cpus;
+}
+
+// Bind the current thread to the single CPU, return false on failure
+static bool PinThread (int cpu)
+{
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO (&set);
+    CPU_SET (cpu, &set);
+    return pthread_setaffinity_np (pthread_self(), sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+    return cpu < int(8*sizeof(DWORD_PTR))  &&  SetThreadAffinityMask (GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#else
+    return false;
+#endif
+}
+
+
+/***********************************************************************************************************************
+*** Thread pool ********************************************************************************************************
+************************************************************************************************************************/
+
+// Pool configuration, applied when the pool is used for the first time:
+//   threads:  total number of threads including the thread waiting for results, 0 means the number of CPUs (or the affinity list size)
+//   affinity: "none" disables pinning, "" pins threads to the CPUs available to the process in their order, otherwise it's the CPU list like "0-15,32-47"
+// Defaults are taken from the FASTECC_THREADS and FASTECC_AFFINITY environment variables
+struct ThreadPoolConfig
+{
+    size_t threads;
+    std::string affinity;
+
+    ThreadPoolConfig()
+    {
+        const char* env_threads  = getenv("FASTECC_THREADS");
+        const char* env_affinity = getenv("FASTECC_AFFINITY");
+        threads  = (env_threads?  size_t(atoi(env_threads)) : 0);
+        affinity = (env_affinity? env_affinity : "");
+    }
+
+    static ThreadPoolConfig& Get()  {static ThreadPoolConfig config;  return config;}
+};
+
+class ThreadPool
+{
+    struct Task
+    {
+        std::function<void()> func;
+        std::atomic<size_t>* pending;       // counter of unfinished tasks in the group, decremented after execution
+    };
+
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;    // queues[0] is shared by threads not belonging to the pool, queues[i] belongs to worker i
+    std::vector<std::thread> workers;
+    std::vector<int> cpus;                          // CPU assigned to each thread, empty without pinning
+    std::atomic<size_t> pinned{0};                  // number of workers successfully pinned
+
+    std::atomic<size_t> queued{0};                  // number of tasks in all queues
+    std::atomic<size_t> sleeping{0};                // number of workers waiting on the wakeup
+    std::mutex sleep_lock;
+    std::condition_variable wakeup;
+    bool stop = false;
+
+    static int& Self()  {static thread_local int self = 0;  return self;}     // index of the current worker, 0 for other threads
+
+    ThreadPool()
+    {
+        ThreadPoolConfig& config = ThreadPoolConfig::Get();
+        bool pin = (config.affinity != "none");
+        std::vector<int> available = (pin && config.affinity != ""?  ParseCPUs (config.affinity.c_str()) : ProcessCPUs());
+        if (available.empty())  available = ProcessCPUs();
+        size_t threads = (config.threads? config.threads : available.size());
+        if (pin)
+            for (size_t i=0; i<threads; i++)
+                cpus.push_back (available[i % available.size()]);
+
+        // The thread waiting for results works as the thread 0, so only threads-1 workers are started, pinned to cpus[1..]
+        for (size_t i=0; i<threads; i++)
+            queues.emplace_back (new Queue);
+        std::atomic<size_t> started{0};
+        for (size_t i=1; i<threads; i++)
+            workers.emplace_back ([this, i, &started]
+            {
+                Self() = int(i);
+                if (!cpus.empty() && PinThread (cpus[i]))
+                    pinned++;
+                started++;
+                WorkerLoop();
+            });
+        while (started < workers.size())
+            std::this_thread::yield();
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard (sleep_lock);
+            stop = true;
+        }
+        wakeup.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    // Pop the latest task from the own queue, or steal the oldest task from other ones
+    bool Pop (Task& task)
+    {
+        size_t self = Self(),  n = queues.size();
+        for (size_t k=0; k<n; k++) {
+            Queue& q = *queues[(self+k) % n];
+            std::lock_guard<std::mutex> guard (q.lock);
+            if (q.tasks.empty())  continue;
+            if (k==0)  task = std::move (q.tasks.back()),   q.tasks.pop_back();
+            else       task = std::move (q.tasks.front()),  q.tasks.pop_front();
+            queued--;
+            return true;
+        }
+        return false;
+    }
+
+    // Execute one task, return false if there are no tasks
+    bool RunOne()
+    {
+        Task task;
+        if (queued == 0  ||  !Pop (task))  return false;
+        task.func();
+        (*task.pending)--;
+        return true;
+    }
+
+    void WorkerLoop()
+    {
+        for (;;) {
+            if (RunOne())  continue;
+            for (int spin=0; spin<1000 && queued==0; spin++)
+                std::this_thread::yield();
+            if (queued > 0)  continue;
+
+            std::unique_lock<std::mutex> guard (sleep_lock);
+            sleeping++;
+            wakeup.wait (guard, [this]{return stop || queued > 0;});
+            sleeping--;
+            if (stop)  return;
+        }
+    }
+
+public:
+    static ThreadPool& Instance()  {static ThreadPool pool;  return pool;}
+
+    // Total number of threads, including the thread waiting for results
+    size_t Threads() const  {return queues.size();}
+
+    // Description for the verbose mode
+    std::string Description() const
+    {
+        char buf[99];
+        sprintf (buf, "%.0lf threads", Threads()*1.0);
+        std::string result = buf;
+        if (!workers.empty())
+            sprintf (buf, ", %.0lf of %.0lf workers pinned to CPUs", size_t(pinned)*1.0, workers.size()*1.0),  result += buf;
+        return result;
+    }
+
+    // Add the task to the queue of the current thread, incrementing the pending counter
+    void Submit (std::function<void()> func, std::atomic<size_t>& pending)
+    {
+        pending++;
+        queued++;
+        Queue& q = *queues[Self()];
+        {
+            std::lock_guard<std::mutex> guard (q.lock);
+            q.tasks.push_back (Task {std::move(func), &pending});
+        }
+        if (sleeping > 0) {
+            std::lock_guard<std::mutex> guard (sleep_lock);
+            wakeup.notify_one();
+        }
+    }
+
+    // Execute any tasks until all tasks of the group are finished
+    void Wait (std::atomic<size_t>& pending)
+    {
+        while (pending > 0)
+            if (!RunOne())
+                std::this_thread::yield();
+    }
+};
+
+
+// While the SerialRegion object exists, parallel loops and task groups started by the current thread are executed by this thread alone.
+// It's used by batches of small independent jobs, that are parallelized only at the top level, avoiding the per-task overheads
+class SerialRegion
+{
+public:
+    static int& Depth()  {static thread_local int depth = 0;  return depth;}
+    static bool Active() {return Depth() > 0;}
+    SerialRegion()       {Depth()++;}
+    ~SerialRegion()      {Depth()--;}
+};
+
+
+// Group of tasks executed by the pool, f.e. two halves of the recursive NTT
+class TaskGroup
+{
+    std::atomic<size_t> pending{0};
+public:
+    template <typename Func>
+    void Run (Func func)  {if (SerialRegion::Active())  func();  else  ThreadPool::Instance().Submit (func, pending);}
+    void Wait()           {ThreadPool::Instance().Wait (pending);}
+    ~TaskGroup()          {Wait();}
+};
+
+
+// Split [begin,end) into halves, submitting the second half as the task, until the range is no larger than grain
+template <typename Body>
+void ParallelForSplit (ptrdiff_t begin, ptrdiff_t end, ptrdiff_t grain, const Body& body, std::atomic<size_t>& pending)
+{
+    while (end-begin > grain) {
+        ptrdiff_t mid = begin + (end-begin)/2;
+        ThreadPool::Instance().Submit ([=, &body, &pending]{ParallelForSplit (mid, end, grain, body, pending);}, pending);
+        end = mid;
+    }
+    for (ptrdiff_t i=begin; i<end; i++)
+        body(i);
+}
+
+// Execute body(i) for each i in [begin,end) in parallel. By default, the range is split into 4 parts per thread
+// (grain is the maximum number of iterations per task), so idle threads can steal the work of slower ones
+template <typename Body>
+void ParallelFor (ptrdiff_t begin, ptrdiff_t end, const Body& body, ptrdiff_t grain = 0)
+{
+    if (end <= begin)  return;
+    ThreadPool& pool = ThreadPool::Instance();
+    if (grain <= 0)
+        grain = std::max ((end-begin) / ptrdiff_t(4*pool.Threads()),  ptrdiff_t(1));
+    if (pool.Threads() == 1  ||  end-begin <= grain  ||  SerialRegion::Active()) {
+        for (ptrdiff_t i=begin; i<end; i++)
+            body(i);
+        return;
+    }
+    std::atomic<size_t> pending{0};
+    ParallelForSplit (begin, end, grain, body, pending);
+    pool.Wait (pending);
+}
@@ -0,0 +1,183 @@
+/// Cache size detection and FFTW-style "wisdom": NTT parameters found by the autotuner (NTT_Autotune in ntt.cpp),
+/// saved to the file and loaded by later runs
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <tuple>
+
+#if (defined(__GNUC__) || defined(_MSC_VER)) && (defined(MY_CPU_AMD64) || defined(_M_IX86) || defined(__i386__))
+#define TUNING_CPUID
+#if __GNUC__
+#include <cpuid.h>
+#else
+#include <intrin.h>
+#endif
+#endif
+
+
+/***********************************************************************************************************************
+*** Cache size detection ***********************************************************************************************
+************************************************************************************************************************/
+
+// Number of CPUs in the sysfs list like "0-3,8,10-11"
+static int CountCPUs (const char* list)
+{
+    int count = 0;
+    while (*list) {
+        char* end;
+        long first = strtol (list, &end, 10),  last = first;
+        if (end == list)  break;
+        if (*end == '-')  last = strtol (end+1, &end, 10);
+        count += int(last-first+1);
+        list = end + (*end == ',');
+    }
+    return count;
+}
+
+// Find size of the L2 cache (in bytes) and number of logical CPUs sharing it, using Linux sysfs or x86 cpuid. Return false if unknown
+static bool DetectL2Cache (size_t* size, int* shared)
+{
+    // Linux sysfs: /sys/devices/system/cpu/cpu0/cache/indexN/{level,type,size,shared_cpu_list}
+    for (int i=0; i<16; i++) {
+        char path[99], buf[999];
+        int level = 0;  long kb = 0;
+        sprintf (path, "/sys/devices/system/cpu/cpu0/cache/index%d/", i);
+        std::string dir = path;
+        FILE* f;
+        if ((f = fopen ((dir+"level").c_str(), "r")) == 0)  break;
+        if (fscanf (f, "%d", &level) != 1)  level = 0;
+        fclose (f);
+        if (level != 2)  continue;
+        if ((f = fopen ((dir+"type").c_str(), "r")) == 0)  continue;
+        if (fscanf (f, "%998s", buf) != 1  ||  strcmp (buf, "Instruction") == 0)  {fclose (f); continue;}
+        fclose (f);
+        if ((f = fopen ((dir+"size").c_str(), "r")) == 0)  continue;
+        if (fscanf (f, "%ldK", &kb) != 1)  kb = 0;
+        fclose (f);
+        *shared = 1;
+        if ((f = fopen ((dir+"shared_cpu_list").c_str(), "r")) != 0) {
+            if (fscanf (f, "%998s", buf) == 1)  *shared = std::max (CountCPUs (buf), 1);
+            fclose (f);
+        }
+        *size = size_t(kb) * 1024;
+        if (kb > 0)  return true;
+    }
+
+#ifdef TUNING_CPUID
+    // x86 deterministic cache parameters: cpuid leaf 4 on Intel, 0x8000001D on AMD
+    for (unsigned leaf : {4u, 0x8000001Du}) {
+        unsigned r[4] = {0,0,0,0};
+#if __GNUC__
+        if (__get_cpuid_max (leaf & 0x80000000, 0) < leaf)  continue;
+#else
+        int info[4];  __cpuid (info, leaf & 0x80000000);
+        if (unsigned(info[0]) < leaf)  continue;
+#endif
+        for (unsigned i=0; i<16; i++) {
+#if __GNUC__
+            __cpuid_count (leaf, i, r[0], r[1], r[2], r[3]);
+#else
+            __cpuidex (info, leaf, i);  for (int k=0; k<4; k++)  r[k] = info[k];
+#endif
+            unsigned type = r[0] & 31,  level = (r[0] >> 5) & 7;
+            if (type == 0)  break;                       // no more caches
+            if (level != 2  ||  type == 2)  continue;    // we need L2 data or unified cache
+            size_t ways = (r[1] >> 22) + 1,  partitions = ((r[1] >> 12) & 1023) + 1,  line = (r[1] & 4095) + 1,  sets = size_t(r[2]) + 1;
+            *size = ways * partitions * line * sets;
+            *shared = int((r[0] >> 14) & 4095) + 1;
+            return true;
+        }
+    }
+#endif
+    return false;
+}
+
+// Part of L2 cache owned by each CPU core/thread: the detected L2 size divided by the number of threads sharing it.
+// Only 3/4 of that is used, since 4/8-associative caches can't be filled completely due to hashing. Larger caches are limited to 512 KB,
+// since on a Xeon with 2 MB L2 larger subproblems made MFA_NTT slower. When the cache can't be detected, we use 96 KB tuned
+// for i7-4770 (256 KB per core shared by 2 threads). Environment variable FASTECC_L2CACHE overrides the value (in KB)
+inline size_t L2Cache()
+{
+    static size_t cache = []
+    {
+        const char* env = getenv("FASTECC_L2CACHE");     // override, in KB
+        if (env && atoi(env) > 0)
+            return size_t(atoi(env)) * 1024;
+        size_t size;  int shared;
+        if (!DetectL2Cache (&size, &shared))
+            return size_t(96*1024);
+        return std::min (std::max (size / shared / 4 * 3,  size_t(16*1024)),  size_t(512*1024));
+    }();
+    return cache;
+}
+
+
+/***********************************************************************************************************************
+*** Wisdom *************************************************************************************************************
+************************************************************************************************************************/
+
+// Wisdom is the table of tuned parameters, f.e. number of rows R in the MFA_NTT R*C split, for each (algorithm, P, N, block size in bytes).
+// The wisdom file holds one entry per line: "algorithm P N bytes value", f.e. "MFA_NTT 0xFFF00001 1048576 2052 128"
+typedef std::tuple<std::string, uint64_t, uint64_t, uint64_t>  WisdomKey;
+
+inline std::map<WisdomKey, uint64_t>& Wisdom()
+{
+    static std::map<WisdomKey, uint64_t> wisdom;
+    return wisdom;
+}
+
+// Find the tuned parameter value, return false if it's unknown
+inline bool WisdomLookup (const char* algo, uint64_t P, size_t N, size_t bytes, size_t* value)
+{
+    std::map<WisdomKey, uint64_t>& wisdom = Wisdom();
+    if (wisdom.empty())  return false;
+    auto it = wisdom.find (WisdomKey (algo, P, N, bytes));
+    if (it == wisdom.end())  return false;
+    *value = size_t(it->second);
+    return true;
+}
+
+inline void WisdomStore (const char* algo, uint64_t P, size_t N, size_t bytes, size_t value)
+{
+    Wisdom()[WisdomKey (algo, P, N, bytes)] = value;
+}
+
+inline void WisdomForget (const char* algo, uint64_t P, size_t N, size_t bytes)
+{
+    Wisdom().erase (WisdomKey (algo, P, N, bytes));
+}
+
+// Wisdom file name: value of the FASTECC_WISDOM environment variable or "fastecc.wisdom" in the current directory
+inline const char* WisdomFilename()
+{
+    const char* env = getenv("FASTECC_WISDOM");
+    return (env && *env?  env : "fastecc.wisdom");
+}
+
+// Add entries from the wisdom file to the table, return false if the file can't be read
+inline bool LoadWisdom (const char* filename = WisdomFilename())
+{
+    FILE* f = fopen (filename, "r");
+    if (f == 0)  return false;
+    char algo[99], line[999];
+    unsigned long long P, N, bytes, value;
+    while (fgets (line, sizeof(line), f))
+        if (sscanf (line, "%98s %llx %llu %llu %llu", algo, &P, &N, &bytes, &value) == 5)
+            WisdomStore (algo, P, size_t(N), size_t(bytes), size_t(value));
+    fclose (f);
+    return true;
+}
+
+// Write all entries of the table to the wisdom file, return false on failure
+inline bool SaveWisdom (const char* filename = WisdomFilename())
+{
+    FILE* f = fopen (filename, "w");
+    if (f == 0)  return false;
+    for (auto& entry : Wisdom())
+        fprintf (f, "%s 0x%llX %llu %llu %llu\n", std::get<0>(entry.first).c_str(), (unsigned long long) std::get<1>(entry.first),
+                 (unsigned long long) std::get<2>(entry.first), (unsigned long long) std::get<3>(entry.first), (unsigned long long) entry.second);
+    return fclose (f) == 0;
+}
@@ -11,10 +11,14 @@
 #include <functional>
 #include <vector>
 #include <memory>
+#include <atomic>
 
 #include "wall_clock_timer.h"
 #include "LargePages.cpp"
 #include "GF(p).cpp"
+#include "GF_SIMD.cpp"
+#include "Tuning.cpp"
+#include "ThreadPool.cpp"
 #include "ntt.cpp"
 
 
@@ -28,15 +32,47 @@ void Test_GF_Inv()
     int cnt = 0;
     for (T i=1; i<P; i++)
     {
-        if (i%(1<<20)==0)  std::cout << std::hex << "\r0x" << i << "...";
+        if (i%(1<<20)==0)  std::cout << std::hex << "\r0x" << uint64_t(i) << "...";
         if (GF_Mul<T,P>(i, GF_Inv<T,P>(i)) != 1)
         {
-            std::cout << i << "\n";
+            std::cout << uint64_t(i) << "\n";
             if (++cnt==10) break;
         }
     }
 }
 
+// GF(p^2) has too many elements for the exhaustive test, so check a random sample of 2^22 elements a+b*i
+template <typename T, T P, int BITS>
+void Test_GF2_Inv()
+{
+    using GF2 = GF_Mersenne2<T,BITS>;
+    int cnt = 0;
+    uint64_t rnd = 0x9E3779B97F4A7C15;
+    for (uint64_t n=1; n<=(1<<22); n++)
+    {
+        if (n%(1<<20)==0)  std::cout << std::hex << "\r0x" << n << "...";
+        uint64_t a = (rnd = rnd*6364136223846793005 + 1442695040888963407) >> 3;
+        uint64_t b = (rnd = rnd*6364136223846793005 + 1442695040888963407) >> 3;
+        T x = GF2::Pack (typename GF2::Half (a % GF2::p),  typename GF2::Half (b % GF2::p));
+        if (x == 0)  continue;
+        if (GF_Mul<T,P>(x, GF_Inv<T,P>(x)) != 1)
+        {
+            std::cout << std::hex << "\r" << uint64_t(GF2::Re(x)) << "+" << uint64_t(GF2::Im(x)) << "*i\n";
+            if (++cnt==10) break;
+        }
+    }
+}
+template <> void Test_GF_Inv<uint64_t,0x7FFFFFFF>()
+{
+    Test_GF2_Inv<uint64_t,0x7FFFFFFF,31>();
+}
+#if __GNUC__ && defined(MY_CPU_64BIT)
+template <> void Test_GF_Inv<uint128_t,0x1FFFFFFFFFFFFFFF>()
+{
+    Test_GF2_Inv<uint128_t,0x1FFFFFFFFFFFFFFF,61>();
+}
+#endif
+
 
 // Find first few primary roots of 1 of power N
 template <typename T, T P>
@@ -46,13 +82,21 @@ void FindRoot (T N)
     for (T i=2; i<P; i++)
     {
         if (i<256 || (i%(1024*1024))==0)
-            std::cout << "\r" << i << "**" << std::hex << N << std::dec << "...";
+            std::cout << "\r" << uint64_t(i) << "**" << std::hex << uint64_t(N) << std::dec << "...";
         T q = GF_Pow<T,P> (i,N);
         if (q==1)
         {
 
             if (P==0x10001 || P==0xFFFFFFFF || P==0xFFFFFFFFFFFFFFFF) {
                 if (1 == GF_Pow<T,P> (i,N/2))  goto next;
+            } else if (P==0xFFFFFFFF00000001) {
+                if (1 == GF_Pow<T,P> (i,N/2) ||
+                    1 == GF_Pow<T,P> (i,N/3) ||
+                    1 == GF_Pow<T,P> (i,N/5) ||
+                    1 == GF_Pow<T,P> (i,N/17) ||
+                    1 == GF_Pow<T,P> (i,N/257) ||
+                    1 == GF_Pow<T,P> (i,N/65537))
+                    goto next;
             } else {
                 assert (P==0xFFF00001);  // other P aren' supported
                 if (1 == GF_Pow<T,P> (i,N/2) ||
@@ -83,7 +127,7 @@ void FindRoot (T N)
                 }
             }
 */
-            std::cout << i << "\n";
+            std::cout << uint64_t(i) << "\n";
             if (++cnt==10) break;
         }
         next:;
@@ -98,7 +142,7 @@ void Test_GF_Mul()
     int n = 0;
     for (T i=P-1; i>0; i--)
     {
-        if (i%0x1000==0)  std::cout << std::hex << "\r0x" << i << "...";
+        if (i%0x1000==0)  std::cout << std::hex << "\r0x" << uint64_t(i) << "...";
         for (T j=P-1; j>=i; j--)
         {
             using DoubleT = typename Double<T>::T;
@@ -107,7 +151,7 @@ void Test_GF_Mul()
             if (P==0xFFFFFFFF && b==P)  b=0;
             if (a != b)
             {
-                std::cout << std::hex << "\r" << i << "*" << j << "=" << a << " != " << b << "\n" ;
+                std::cout << std::hex << "\r" << uint64_t(i) << "*" << uint64_t(j) << "=" << uint64_t(a) << " != " << uint64_t(b) << "\n" ;
                 if (++n>10) return;
             }
         }
@@ -117,6 +161,16 @@ template <> void Test_GF_Mul<uint64_t,0xFFFFFFFFFFFFFFFF>()
 {
     printf("Test_GF_Mul<uint64_t>: unsupported\n");
 }
+template <> void Test_GF_Mul<uint64_t,0x7FFFFFFF>()
+{
+    printf("Test_GF_Mul<GF(p^2)>: unsupported\n");
+}
+#if __GNUC__ && defined(MY_CPU_64BIT)
+template <> void Test_GF_Mul<uint128_t,0x1FFFFFFFFFFFFFFF>()
+{
+    printf("Test_GF_Mul<GF(p^2)>: unsupported\n");
+}
+#endif
 
 
 
@@ -161,13 +215,19 @@ void DividersDensity()
 }
 
 
-// Butterfly operation
-template <typename T, T P>
+// Butterfly operation, employing either generic GF_Mul (Mode==0), GF_MulConst with precomputed root (Mode==1)
+// or vectorized kernel (Mode==2, see GF_SIMD.cpp)
+template <typename T, T P, int Mode>
 void Butterfly (T* a, T* b, int TIMES, int SIZE, T root)
 {
+    T root_precomp = GF_MulConstPrecomp<T,P> (root);
     for (int n=0; n<TIMES; n++) {
+        if (Mode==2) {
+            GF_Kernels<T,P>::Butterfly (a, b, SIZE, root, root_precomp);
+            continue;
+        }
         for (int k=0; k<SIZE; k++) {                     // cycle over SIZE elements of the single block
-            T temp = GF_Mul<T,P> (root, b[k]);
+            T temp = Mode==1?  GF_MulConst<T,P> (b[k], root, root_precomp)  :  GF_Mul<T,P> (root, b[k]);
             b[k] = GF_Sub<T,P> (a[k], temp);
             a[k] = GF_Add<T,P> (a[k], temp);
         }
@@ -176,20 +236,19 @@ void Butterfly (T* a, T* b, int TIMES, int SIZE, T root)
 
 
 // Benchmark speed of the Butterfly operation, processing 10 GB data == 500 MB processed with NTT<2**20>
-template <typename T, T P>
+template <typename T, T P, int Mode>
 int BenchButterfly()
 {
-    T x=0;
-    #pragma omp parallel for
-    for (int n=0; n<2560/sizeof(T); n++)
+    std::atomic<uint64_t> x{0};
+    ParallelFor (0, 2560/sizeof(T), [&] (ptrdiff_t)
     {
         const int sz = 4096;
         T a[sz], b[sz];
         for (int i=0; i<sz; i++)
             a[i] = i*7+1, b[i] = i*15+8;
-        Butterfly<T,P> (a, b, 1024, sz, 1557);
-        x += a[0];
-    }
+        Butterfly<T,P,Mode> (a, b, 1024, sz, 1557);
+        x += uint64_t(a[0]);
+    });
     return x?1:0;
 }
 
@@ -231,17 +290,182 @@ void BenchSmallNTT (size_t REPEAT, size_t N, size_t SIZE, const char* P_str)
 
     double processed_size = (P==0x10001? 0.5:1.0) * N*SIZE*sizeof(T);   // In my GF(0x10001) implementation 4-byte value represents only 2 bytes of real data
 
-    time_it (processed_size*REPEAT, title, [&]{for(int i=0; i<REPEAT; i++) MFA_NTT <T,P> (data, N, SIZE, false);});
+    NTTPlan<T,P> plan(N, BenchKernel());
+    time_it (processed_size*REPEAT, title, [&]{for(size_t i=0; i<REPEAT; i++) MFA_NTT <T,P> (data, N, SIZE, false, plan);});
 }
 
 
-// Benchmark and verify two NTT implementations: Rec_NTT() & MFA_NTT(), compare results to definitive Slow_NTT()
+// Perform the same sequence of TransposeMatrix calls as the MFA_NTT
 template <typename T, T P>
-void BenchNTT (bool RunOld, bool RunCanonical, size_t N, size_t SIZE, const char* P_str)
+void MFA_Transposes (T** data, size_t N, size_t SIZE, T** scratch)
+{
+    size_t R = MFA_Rows<T,P> (N, SIZE);
+    if (R == 0)  return;
+    size_t C = N/R;
+    TransposeMatrix (data, R, C, scratch);
+    TransposeMatrix (data, C, R, scratch);
+    if (R < C)
+        ParallelFor (0, R, [&] (ptrdiff_t r) {
+            MFA_Transposes<T,P> (data+r*C, C, SIZE, scratch+r*C);
+        }, 1);
+    TransposeMatrix (data, R, C, scratch);
+}
+
+
+// Benchmark TransposeMatrix calls made by the MFA_NTT, compared to the MFA_NTT itself. Block pointers are permuted
+// REPEAT times, and the speed is computed for the full data size, so the ratio of both speeds is the transposition share of the MFA_NTT time
+template <typename T, T P>
+void BenchTranspose (size_t N, size_t SIZE, const char* P_str)
+{
+    T *data0 = VAlloc<T> (uint64_t(N)*SIZE);
+    if (data0==0)  {printf("Can't alloc %.0lf MiB of memory!\n", (N/1048576.0)*SIZE*sizeof(T)); return;}
+
+    for (size_t i=0; i<N*SIZE; i++)
+        data0[i] = i%P;
+
+    T **data = new T* [N];      // pointers to blocks
+    for (size_t i=0; i<N; i++)
+        data[i] = data0 + i*SIZE;
+
+    size_t R = MFA_Rows<T,P> (N, SIZE),  REPEAT = 100;
+    if (R == 0)  {printf("MFA_NTT isn't used for this geometry\n"); return;}
+
+    double processed_size = (P==0x10001? 0.5:1.0) * N*SIZE*sizeof(T);   // In my GF(0x10001) implementation 4-byte value represents only 2 bytes of real data
+    NTTPlan<T,P> plan(N, BenchKernel());
+
+    char title[999];
+    sprintf (title, "MFA_NTT<2^%.0lf,%.0lf,P=%s>", logb(N), SIZE*1.0*sizeof(T), P_str);
+    time_it (processed_size, title, [&]{MFA_NTT <T,P> (data, N, SIZE, false, plan);});
+
+    sprintf (title, "TransposeMatrix<%.0lf*%.0lf%s>*%.0lf", R*1.0, N*1.0/R, (R < N/R? " cube":""), REPEAT*1.0);
+    TransposeScratch<T,P> scratch (plan, N);
+    time_it (processed_size*REPEAT, title, [&]{for(size_t i=0; i<REPEAT; i++) MFA_Transposes<T,P> (data, N, SIZE, scratch.ptr);});
+}
+
+
+// Benchmark batch of independent small NTTs, ~256 MiB overall: first performed one at a time, then by the MFA_NTT_Batch
+// distributing them over the threads. Results of both runs should be the same
+template <typename T, T P>
+void BenchBatchNTT (size_t N, size_t SIZE, const char* P_str)
+{
+    size_t COUNT = std::max ((size_t(256) << 20) / (N*SIZE*sizeof(T)), size_t(1));
+    T *data0 = VAlloc<T> (uint64_t(COUNT)*N*SIZE);
+    if (data0==0)  {printf("Can't alloc %.0lf MiB of memory!\n", (COUNT*N/1048576.0)*SIZE*sizeof(T)); return;}
+
+    T **data = new T* [COUNT*N];    // pointers to blocks, transform i uses data[i*N..i*N+N-1]
+    auto init = [&]
+    {
+        for (size_t i=0; i<COUNT*N*SIZE; i++)
+            data0[i] = i%P;
+        for (size_t i=0; i<COUNT*N; i++)
+            data[i] = data0 + i*SIZE;
+    };
+
+    double processed_size = (P==0x10001? 0.5:1.0) * COUNT*N*SIZE*sizeof(T);   // In my GF(0x10001) implementation 4-byte value represents only 2 bytes of real data
+    NTTPlan<T,P> plan(N, BenchKernel());
+    char title[999];
+
+    init();
+    sprintf (title, "MFA_NTT<2^%.0lf,%.0lf,P=%s>*%.0lf one at a time", logb(N), SIZE*1.0*sizeof(T), P_str, COUNT*1.0);
+    time_it (processed_size, title, [&]{for (size_t i=0; i<COUNT; i++)  MFA_NTT <T,P> (data+i*N, N, SIZE, false, plan);});
+    uint32_t hash1 = hash(data, COUNT*N, SIZE);
+
+    init();
+    sprintf (title, "MFA_NTT_Batch<2^%.0lf,%.0lf,P=%s>*%.0lf", logb(N), SIZE*1.0*sizeof(T), P_str, COUNT*1.0);
+    time_it (processed_size, title, [&]{MFA_NTT_Batch <T,P> (data, COUNT, N, SIZE, false, plan);});
+    uint32_t hash2 = hash(data, COUNT*N, SIZE);
+
+    if (hash1==hash2) {
+        if (verbose)  printf("Verified!  After NTT: %.0lf\n", double(hash1));
+    } else {
+        printf("Batch mismatch: one at a time %.0lf,  batch %.0lf\n", double(hash1), double(hash2));
+    }
+    delete[] data;
+    VFree (data0);
+}
+
+
+// Compare MFA_NTT on block pointers, MFA_NTT on block pointers followed by gathering the output into the second buffer in the natural order,
+// and MFA_NTT on the contiguous buffer, producing the natural-order output in-place. Verify that all three results are the same
+template <typename T, T P>
+void BenchLayout (size_t N, size_t SIZE, const char* P_str)
+{
+    T *data0 = VAlloc<T> (2*uint64_t(N)*SIZE);
+    if (data0==0)  {printf("Can't alloc %.0lf MiB of memory!\n", (2*N/1048576.0)*SIZE*sizeof(T)); return;}
+    T *out = data0 + N*SIZE;
+
+    T **data = new T* [N];      // pointers to blocks
+    auto init = [&]
+    {
+        for (size_t i=0; i<N*SIZE; i++)
+            data0[i] = i%P;
+        for (size_t i=0; i<N; i++)
+            data[i] = data0 + i*SIZE;
+    };
+
+    double processed_size = (P==0x10001? 0.5:1.0) * N*SIZE*sizeof(T);   // In my GF(0x10001) implementation 4-byte value represents only 2 bytes of real data
+    NTTPlan<T,P> plan(N, BenchKernel());
+    char title[999];
+
+    init();
+    sprintf (title, "MFA_NTT<2^%.0lf,%.0lf,P=%s> on block pointers", logb(N), SIZE*1.0*sizeof(T), P_str);
+    time_it (processed_size, title, [&]{MFA_NTT <T,P> (data, N, SIZE, false, plan);});
+    uint32_t hash1 = hash(data, N, SIZE);
+
+    init();
+    memset (out, 0, N*SIZE*sizeof(T));     // don't count page faults of the first access
+    sprintf (title, "MFA_NTT<2^%.0lf,%.0lf,P=%s> on block pointers + gather", logb(N), SIZE*1.0*sizeof(T), P_str);
+    time_it (processed_size, title, [&]
+    {
+        MFA_NTT <T,P> (data, N, SIZE, false, plan);
+        ParallelFor (0, N, [&] (ptrdiff_t i) {memcpy (out + i*SIZE, data[i], SIZE*sizeof(T));});
+    });
+    for (size_t i=0; i<N; i++)
+        data[i] = out + i*SIZE;
+    uint32_t hash2 = hash(data, N, SIZE);
+
+    init();
+    sprintf (title, "MFA_NTT<2^%.0lf,%.0lf,P=%s> on contiguous buffer", logb(N), SIZE*1.0*sizeof(T), P_str);
+    time_it (processed_size, title, [&]{MFA_NTT <T,P> (data0, N, SIZE, SIZE, false, plan);});
+    uint32_t hash3 = hash(data, N, SIZE);     // data[] still points to the blocks in their memory order
+
+    if (hash1==hash2 && hash1==hash3) {
+        if (verbose)  printf("Verified!  After NTT: %.0lf\n", double(hash1));
+    } else {
+        printf("Layout mismatch: block pointers %.0lf,  gathered %.0lf,  contiguous %.0lf\n", double(hash1), double(hash2), double(hash3));
+    }
+    delete[] data;
+    VFree (data0);
+}
+
+
+// Autotune NTT parameters for the given geometry and save them to the wisdom file
+template <typename T, T P>
+void Autotune (size_t N, size_t SIZE)
+{
+    T *data0 = VAlloc<T> (uint64_t(N)*SIZE);
+    if (data0==0)  {printf("Can't alloc %.0lf MiB of memory!\n", (N/1048576.0)*SIZE*sizeof(T)); return;}
+
+    for (size_t i=0; i<N*SIZE; i++)
+        data0[i] = i%P;
+
+    T **data = new T* [N];      // pointers to blocks
+    for (size_t i=0; i<N; i++)
+        data[i] = data0 + i*SIZE;
+
+    NTTPlan<T,P> plan(N, BenchKernel());
+    NTT_Autotune<T,P> (data, N, SIZE, plan, verbose);
+
+    if (SaveWisdom())  printf("Wisdom saved to %s\n", WisdomFilename());
+    else               printf("Can't write wisdom to %s\n", WisdomFilename());
+}
+
+
+// Benchmark and verify NTT implementations: Rec_NTT(), MFA_NTT(), Generic_NTT() & small-order codelets (Codelet!=0),
+// compare results to definitive Slow_NTT()
+template <typename T, T P>
+void BenchNTT (bool RunOld, bool RunCanonical, bool RunGeneric, size_t Codelet, size_t N, size_t SIZE, const char* P_str)
 {
-    bool RunNTT3  =  (N%3 == 0);
-    bool RunNTT6  =  (N%6 == 0);
-    bool RunNTT9  =  (N%9 == 0);
 
     T *data0 = VAlloc<T> (uint64_t(N)*SIZE);
     if (data0==0)  {printf("Can't alloc %.0lf MiB of memory!\n", (N/1048576.0)*SIZE*sizeof(T)); return;}
@@ -256,20 +480,24 @@ void BenchNTT (bool RunOld, bool RunCanonical, size_t N, size_t SIZE, const char
     uint32_t hash0 = hash(data, N, SIZE);    // hash of original data
 
     char title[999];
-    int divider = RunOld? N : RunNTT9? 9 : RunNTT6? 6 : RunNTT3? 3 : N;
-    sprintf (title, "NTT%d<%d*%.0lf,%.0lf,P=%s>", divider, divider, N*1.0/divider, SIZE*1.0*sizeof(T), P_str);
-    for (int i=64; i--; )
+    size_t divider = (Codelet? Codelet : N);
+    if (Codelet)
+        sprintf (title, "NTT%d<%d*%.0lf,%.0lf,P=%s>", int(divider), int(divider), N*1.0/divider, SIZE*1.0*sizeof(T), P_str);
+    else if (RunGeneric)
+        sprintf (title, "Generic_NTT<%.0lf,%.0lf,P=%s>", N*1.0, SIZE*1.0*sizeof(T), P_str);
+    else for (int i=64; i--; )
         if (T(1)<<i == N)
             sprintf (title, "%s<2^%d,%.0lf,P=%s>", RunCanonical?"Slow_NTT":RunOld?"Rec_NTT":"MFA_NTT", i, SIZE*1.0*sizeof(T), P_str);
 
     double processed_size = (P==0x10001? 0.5:1.0) * N*SIZE*sizeof(T);   // In my GF(0x10001) implementation 4-byte value represents only 2 bytes of real data
 
-         if (RunOld)       time_it (processed_size, title, [&]{Rec_NTT <T,P> (data, N, SIZE, false);});
-    else if (RunNTT9)      time_it (processed_size, title, [&]{NTT9<T,P,false> (data, N/divider, SIZE);});
-    else if (RunNTT6)      time_it (processed_size, title, [&]{NTT6<T,P,false> (data, N/divider, SIZE);});
-    else if (RunNTT3)      time_it (processed_size, title, [&]{NTT3<T,P,false> (data, N/divider, SIZE);});
+    NTTPlan<T,P> plan(N & (0-N), BenchKernel());   // the largest power of 2 dividing N
+
+         if (RunOld)       time_it (processed_size, title, [&]{Rec_NTT <T,P> (data, N, SIZE, false, plan);});
+    else if (RunGeneric)   time_it (processed_size, title, [&]{Generic_NTT <T,P> (data, N, SIZE, false, plan);});
+    else if (Codelet)      time_it (processed_size, title, [&]{SmallNTT<T,P,false> (data, Codelet, N/Codelet, SIZE);});
     else if (RunCanonical) time_it (processed_size, title, [&]{Slow_NTT<T,P> (data0,N, SIZE, false);});
-    else                   time_it (processed_size, title, [&]{MFA_NTT <T,P> (data, N, SIZE, false);});
+    else                   time_it (processed_size, title, [&]{MFA_NTT <T,P> (data, N, SIZE, false, plan);});
 
     // Pack results into 0..P-1 range
     for (size_t i=0; i<N*SIZE; i++)
@@ -278,17 +506,16 @@ void BenchNTT (bool RunOld, bool RunCanonical, size_t N, size_t SIZE, const char
     uint32_t hash1 = hash(data, N, SIZE);    // hash after NTT
 
     // Inverse NTT
-         if (RunOld)       Rec_NTT <T,P> (data, N, SIZE, true);
-    else if (RunNTT9)      NTT9<T,P,true>(data, N/9, SIZE);
-    else if (RunNTT6)      NTT6<T,P,true>(data, N/6, SIZE);
-    else if (RunNTT3)      NTT3<T,P,true>(data, N/3, SIZE);
+         if (RunOld)       Rec_NTT <T,P> (data, N, SIZE, true, plan);
+    else if (RunGeneric)   Generic_NTT <T,P> (data, N, SIZE, true, plan);
+    else if (Codelet)      SmallNTT<T,P,true> (data, Codelet, N/Codelet, SIZE);
     else if (RunCanonical) Slow_NTT<T,P> (data0,N, SIZE, true);
-    else                   MFA_NTT <T,P> (data, N, SIZE, true);
+    else                   MFA_NTT <T,P> (data, N, SIZE, true, plan);
 
     // Normalize the result by dividing by N and pack results into 0..P-1 range
     T inv_N = GF_Inv<T,P>(divider);
     for (size_t i=0; i<N*SIZE; i++)
-        data0[i] = GF_Normalize<T,P> (GF_Mul<T,P> (data0[i], inv_N));
+        data0[i] = GF_Normalize<T,P> (GF_Mul<T,P> (GF_Normalize<T,P> (data0[i]), inv_N));
 
     // Now we should have exactly the input data
     uint32_t hash2 = hash(data, N, SIZE);    // hash after NTT+iNTT
@@ -311,21 +538,47 @@ void Code (int argc, char **argv, const char* P_str)
     char opt  =  (argc>=2?  argv[1][0] : ' ');
     if (opt=='i')  {Test_GF_Inv<T,P>();  return;}
     if (opt=='m')  {Test_GF_Mul<T,P>();  return;}
-    if (opt=='r')  {FindRoot<T,P>(P==0xFFFFFFFFFFFFFFFF?(uint64_t(65536)*2*5*17449):P==0xFFFFFFFF?65536:P-1);  printf ("GF_Root %s\n", GF_Root<T,P>(2)==P-1? "OK": "failed");  return;}
+    if (opt=='r')  {if (GF_GroupOrder<T,P>() < P)  FindRoot<T,P>(P==0xFFFFFFFFFFFFFFFF?(uint64_t(65536)*2*5*17449):P==0xFFFFFFFF?65536:P-1);  printf ("GF_Root %s\n", GF_Root<T,P>(2)==P-1? "OK": "failed");  return;}
     if (opt=='d')  {DividersDensity<T,P>();  return;}
-    if (opt=='b')  {time_it ((P==0x10001? 1e10 : 2e10), "Butterfly", [&]{BenchButterfly<T,P>();});  return;}
+    if (opt=='b')  {time_it ((P==0x10001? 1e10 : 2e10), "Butterfly (GF_Mul)",      [&]{BenchButterfly<T,P,0>();});
+                    time_it ((P==0x10001? 1e10 : 2e10), "Butterfly (GF_MulConst)", [&]{BenchButterfly<T,P,1>();});
+                    if (GF_Kernels<T,P>::enabled) {
+                        char title[99];  sprintf (title, "Butterfly (%s kernel)", GF_Kernels<T,P>::Name());
+                        time_it (2e10, title, [&]{BenchButterfly<T,P,2>();});
+                    }
+                    return;}
+
+    if (verbose)  printf("GF kernels: %s, L2 cache per thread: %.0lf KB\nThread pool: %s\n", GF_Kernels<T,P>::Name(), L2Cache()/1024.0, ThreadPool::Instance().Description().c_str());
 
     size_t N = 1<<19;   // NTT order
     size_t SIZE = 2052; // Block size, in bytes
                         // 1 GB total
-    if (opt=='s')  N = 32;
+    if (opt=='s' || opt=='c')  N = (opt=='s'? 32 : 256);
+    while (GF_GroupOrder<T,P>() % N)  N /= 2;   // default order should be supported by the small P, f.e. 2^16 for P=0x10001
 
-    if (argc>=3)  N = 1<<atoi(argv[2]);
+    if (argc>=3)  N = (opt=='g'?  atoi(argv[2]) : 1<<atoi(argv[2]));   // 'g' accepts any NTT order
     if (argc>=4)  SIZE = atoi(argv[3]);
 
-    assert(N<P);  // Too long NTT for the such small P
+    // Numeric option selects the codelet order, and N is the number of codelet invocations
+    size_t Codelet = (isdigit(opt)? atoi(argv[1]) : 0);
+    if (Codelet)  {
+        if (argc<3)  N = 1<<16;
+        N *= Codelet;
+        bool supported = false;
+        for (size_t order : {2,3,4,5,6,7,9,12,13})
+            if (Codelet == order)  supported = true;
+        if (!supported || P==0xFFFFFFFF || P==0xFFFFFFFFFFFFFFFF || GF_GroupOrder<T,P>() % Codelet)
+            {printf("Unsupported codelet order %d\n", int(Codelet));  return;}
+    }
+
+    assert(Codelet || N<P);  // Too long NTT for the such small P. In the codelet mode, N is the number of codelet invocations
+    if (opt=='g' && GF_GroupOrder<T,P>() % N)  {printf("NTT order %.0lf doesn't divide the group order\n", N*1.0);  return;}
     if (opt=='s')  BenchSmallNTT<T,P> ((1<<20) / N, N, SIZE/sizeof(T), P_str);
-    else BenchNTT<T,P> (opt=='o', opt=='q', N, SIZE/sizeof(T), P_str);
+    else if (opt=='t')  BenchTranspose<T,P> (N, SIZE/sizeof(T), P_str);
+    else if (opt=='a')  Autotune<T,P> (N, SIZE/sizeof(T));
+    else if (opt=='l')  BenchLayout<T,P> (N, SIZE/sizeof(T), P_str);
+    else if (opt=='c')  BenchBatchNTT<T,P> (N, SIZE/sizeof(T), P_str);
+    else BenchNTT<T,P> (opt=='o', opt=='q', opt=='g', Codelet, N, SIZE/sizeof(T), P_str);
 }
 
 
@@ -334,9 +587,13 @@ void Code (int argc, char **argv, const char* P_str)
 //   '=': switch to P=0x10001
 //   '-': switch to P=2^32-1 (not a primary number!)
 //   '+': switch to P=2^64-1 (not a primary number!)
+//   '^': switch to P=2^64-2^32+1
+//   '%': switch to GF(p^2) with p=2^31-1
+//   '@': switch to GF(p^2) with p=2^61-1
 int main (int argc, char **argv)
 {
     // InitLargePages();
+    LoadWisdom();
     if (argc>=2 && argv[1][0]=='.') {
         argv[1]++;
         verbose = false;
@@ -353,6 +610,23 @@ int main (int argc, char **argv)
         Code <uint64_t,0xFFFFFFFFFFFFFFFF> (argc, argv, "2^64-1");
 #else
         printf("Computations modulo 2^64-1 are supported only in 64-bit program versions\n");
+#endif
+    } else if (argc>=2 && argv[1][0]=='^') {
+#ifdef MY_CPU_64BIT
+        argv[1]++;
+        Code <uint64_t,0xFFFFFFFF00000001> (argc, argv, "2^64-2^32+1");
+#else
+        printf("Computations modulo 2^64-2^32+1 are supported only in 64-bit program versions\n");
+#endif
+    } else if (argc>=2 && argv[1][0]=='%') {
+        argv[1]++;
+        Code <uint64_t,0x7FFFFFFF> (argc, argv, "(2^31-1)^2");
+    } else if (argc>=2 && argv[1][0]=='@') {
+#if __GNUC__ && defined(MY_CPU_64BIT)
+        argv[1]++;
+        Code <uint128_t,0x1FFFFFFFFFFFFFFF> (argc, argv, "(2^61-1)^2");
+#else
+        printf("Computations in GF((2^61-1)^2) are supported only in 64-bit GCC program versions\n");
 #endif
     } else {
         Code <uint32_t,0xFFF00001> (argc, argv, "0xFFF00001");
@@ -364,7 +638,6 @@ int main (int argc, char **argv)
 "b N SIZE" in cmdline
 replace "(res>X)*P" in GF_Sub with bit arithmetics (compiler can do it itself?)
 MS GF_Mul64 should became faster with the same algo as GCC one
-IterativeNTT_Steps: optional extra twiddle factors in the last cycle so we can avoid them in MFA_NTT
 template<typename GF> {operators +-*^/; static constexpr const GF root3, root3_2...;}
 try to use "double" for GF(p)&Mod(p) operations, it may be faster
     mul/div polynomials in RS decoder?
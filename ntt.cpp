@@ -12,13 +12,38 @@
 *** Small-order NTT codelets *******************************************************************************************
 ************************************************************************************************************************/
 
-// Perform a single order-2 NTT
+// Perform a single order-2 NTT.
+// With lazy reduction (see GF_Lazy), inputs and outputs are in the [0,4P) range, otherwise they are fully reduced
 template <typename T, T P>
 __forceinline void NTT2 (T& __restrict__ f0, T& __restrict__ f1)
 {
-    T u = f0, v = f1;
-    f0 = GF_Add<T,P> (u, v);
-    f1 = GF_Sub<T,P> (u, v);
+    if (GF_Lazy<T,P>::enabled) {
+        T u = GF_Reduce2P<T,P> (f0),  v = GF_Reduce2P<T,P> (f1);
+        f0 = u + v;
+        f1 = u - v + 2*P;
+    } else {
+        T u = f0, v = f1;
+        f0 = GF_Add<T,P> (u, v);
+        f1 = GF_Sub<T,P> (u, v);
+    }
+}
+
+
+// Perform a single order-2 NTT with twiddle factor applied to f1, i.e. the NTT butterfly
+template <typename T, T P>
+__forceinline void NTT2 (T& __restrict__ f0, T& __restrict__ f1, T root, T root_precomp)
+{
+    if (GF_Lazy<T,P>::enabled) {
+        T u = GF_Reduce2P<T,P> (f0);
+        T v = GF_MulConstLazy<T,P> (f1, root, root_precomp);
+        f0 = u + v;
+        f1 = u - v + 2*P;
+    } else {
+        T u = f0;
+        T v = GF_MulConst<T,P> (f1, root, root_precomp);
+        f0 = GF_Add<T,P> (u, v);
+        f1 = GF_Sub<T,P> (u, v);
+    }
 }
 
 
@@ -31,13 +56,15 @@ __forceinline void NTT3 (T& __restrict__ f0, T& __restrict__ f1, T& __restrict__
     static constexpr T root2   = GF_Mul <T,P> (root1, root1);
     static constexpr T const_1 = GF_Div <T,P> (GF_Add <T,P> (root1, root2), 2);
     static constexpr T const_2 = GF_Div <T,P> (GF_Sub <T,P> (root1, root2), 2);
+    static constexpr T const_1_precomp = GF_MulConstPrecomp<T,P> (const_1);
+    static constexpr T const_2_precomp = GF_MulConstPrecomp<T,P> (const_2);
 
     T u = GF_Add<T,P> (f1, f2);     // u = f1+f2
     T v = GF_Sub<T,P> (f1, f2);     // v = f1-f2
     T f1_f2 = u;                    // f1+f2
 
-    u = GF_Mul<T,P> (u, const_1);   // u*(X+Y)/2,  X**3==1, Y==X**2
-    v = GF_Mul<T,P> (v, const_2);   // v*(X-Y)/2
+    u = GF_MulConst<T,P> (u, const_1, const_1_precomp);   // u*(X+Y)/2,  X**3==1, Y==X**2
+    v = GF_MulConst<T,P> (v, const_2, const_2_precomp);   // v*(X-Y)/2
     u = GF_Add<T,P> (f0, u);        // f0 + u*(X+Y)/2
 
     f0 = GF_Add<T,P> (f0, f1_f2);   // f0 := f0+f1+f2
@@ -52,48 +79,61 @@ __forceinline void NTT4 (T& __restrict__ f0, T& __restrict__ f1, T& __restrict__
 {
     static constexpr T root  = GF_Root<T,P> (4);
     static constexpr T root1 = InvNTT? GF_Inv<T,P>(root) : root;
+    static constexpr T root1_precomp = GF_MulConstPrecomp<T,P> (root1);
 
     NTT2<T,P> (f0, f2);                // classic MFA algo
     NTT2<T,P> (f1, f3);
-    f3 = GF_Mul<T,P> (f3, root1);
+    f3 = GF_MulConst<T,P> (f3, root1, root1_precomp);
     NTT2<T,P> (f0, f1);
     NTT2<T,P> (f2, f3);
     std::swap(f1,f2);
 }
 
 
-#if NEVER  // require NTT(roots) which can't be efficiently implemented with current GF type model
-// Perform a single order-5 NTT
+// Constants for Rader's algorithm, that computes NTT of prime order N via cyclic convolution of order N-1.
+// Input and output elements are reordered by powers of g, the generator of the multiplicative group modulo N,
+// so the convolution is performed with the sequence b[q] = root(N)**(g**-q), i.e. by multiplication
+// between two order-(N-1) NTTs. Return k-th element of NTT(b), divided by N-1
+template <typename T, T P>
+constexpr T RaderConst (T N, T g, bool InvNTT, T k)
+{
+    T root = GF_Root<T,P> (N);
+    if (InvNTT)  root = GF_Inv<T,P> (root);
+    T root_conv = GF_Root<T,P> (N-1);       // root employed by the order-(N-1) codelets
+    T g_inv = 1;                             // g**-1 mod N
+    while (g_inv*g % N != 1)  g_inv++;
+
+    T sum = 0,  e = 1;                       // e = g**-q mod N
+    for (T q=0; q<N-1; q++) {
+        sum = GF_Add<T,P> (sum, GF_Mul<T,P> (GF_Pow<T,P> (root, e), GF_Pow<T,P> (root_conv, q*k % (N-1))));
+        e = e*g_inv % N;
+    }
+    return GF_Mul<T,P> (sum, GF_Inv<T,P> (N-1));
+}
+
+
+// Perform a single order-5 NTT: Rader's algorithm with g=2, i.e. inputs and outputs ordered as f1,f2,f4,f3.
+// The second NTT is forward too, since it reverses order of convolution results exactly as required
 template <typename T, T P, bool InvNTT>
 __forceinline void NTT5 (T& __restrict__ f0, T& __restrict__ f1, T& __restrict__ f2, T& __restrict__ f3, T& __restrict__ f4)
 {
-    static constexpr T root  = GF_Root<T,P> (5);
-    static constexpr T root1 = InvNTT? GF_Inv<T,P>(root) : root;
-    static constexpr T root2 = GF_Mul <T,P> (root1, root1);
-    static constexpr T root3 = GF_Mul <T,P> (root2, root1);
-    static constexpr T root4 = GF_Mul <T,P> (root3, root1);
-
-    NTT4<T,P, InvNTT> (f1, f3, f4, f2);
-    // to do: NTT(roots)
-    f1 = GF_Mul <T,P> (f1, root1);
-    f2 = GF_Mul <T,P> (f1, root2);
-    f3 = GF_Mul <T,P> (f1, root3);
-    f4 = GF_Mul <T,P> (f1, root4);
-    NTT4<T,P,!InvNTT> (f1, f3, f4, f2);
-    std::swap(f2,f3);
-
-    T u = f1;
-    u = GF_Add <T,P> (u, f2);
-    u = GF_Add <T,P> (u, f3);
-    u = GF_Add <T,P> (u, f4);
-
-    f1 = GF_Add <T,P> (f0, f1);
-    f2 = GF_Add <T,P> (f0, f2);
-    f3 = GF_Add <T,P> (f0, f3);
-    f4 = GF_Add <T,P> (f0, f4);
-    f0 = GF_Add <T,P> (f0, u);
+    static constexpr T b0 = RaderConst<T,P> (5, 2, InvNTT, 0),  b0_precomp = GF_MulConstPrecomp<T,P> (b0);
+    static constexpr T b1 = RaderConst<T,P> (5, 2, InvNTT, 1),  b1_precomp = GF_MulConstPrecomp<T,P> (b1);
+    static constexpr T b2 = RaderConst<T,P> (5, 2, InvNTT, 2),  b2_precomp = GF_MulConstPrecomp<T,P> (b2);
+    static constexpr T b3 = RaderConst<T,P> (5, 2, InvNTT, 3),  b3_precomp = GF_MulConstPrecomp<T,P> (b3);
+
+    T x0 = f0;
+    NTT4<T,P,false> (f1, f2, f4, f3);
+    f0 = GF_Add<T,P> (x0, f1);       // f0 := sum of all inputs
+
+    f1 = GF_MulConst<T,P> (f1, b0, b0_precomp);
+    f2 = GF_MulConst<T,P> (f2, b1, b1_precomp);
+    f4 = GF_MulConst<T,P> (f4, b2, b2_precomp);
+    f3 = GF_MulConst<T,P> (f3, b3, b3_precomp);
+    f1 = GF_Add<T,P> (f1, x0);       // adds x0 to every output of the following NTT
+
+    NTT4<T,P,false> (f1, f2, f4, f3);
 }
-#endif
 
 
 // Perform a single order-6 NTT
@@ -101,8 +141,10 @@ template <typename T, T P, bool InvNTT>
 __forceinline void NTT6 (T& __restrict__ f0, T& __restrict__ f1, T& __restrict__ f2,
                          T& __restrict__ f3, T& __restrict__ f4, T& __restrict__ f5)
 {
-    NTT3<T,P,InvNTT> (f0, f2, f4);
-    NTT3<T,P,InvNTT> (f3, f5, f1);
+    // Prime-factor algorithm: input i = 3*i1 + 2*i2 mod 6. Order-3 NTTs employ the inverse root
+    // in order to produce output in the natural order without extra permutation
+    NTT3<T,P,!InvNTT> (f0, f2, f4);
+    NTT3<T,P,!InvNTT> (f3, f5, f1);
 
     NTT2<T,P> (f0, f3);
     NTT2<T,P> (f2, f5);
@@ -110,6 +152,34 @@ __forceinline void NTT6 (T& __restrict__ f0, T& __restrict__ f1, T& __restrict__
 }
 
 
+// Perform a single order-7 NTT: Rader's algorithm with g=3, i.e. inputs and outputs ordered as f1,f3,f2,f6,f4,f5
+template <typename T, T P, bool InvNTT>
+__forceinline void NTT7 (T& __restrict__ f0, T& __restrict__ f1, T& __restrict__ f2, T& __restrict__ f3,
+                         T& __restrict__ f4, T& __restrict__ f5, T& __restrict__ f6)
+{
+    static constexpr T b0 = RaderConst<T,P> (7, 3, InvNTT, 0),  b0_precomp = GF_MulConstPrecomp<T,P> (b0);
+    static constexpr T b1 = RaderConst<T,P> (7, 3, InvNTT, 1),  b1_precomp = GF_MulConstPrecomp<T,P> (b1);
+    static constexpr T b2 = RaderConst<T,P> (7, 3, InvNTT, 2),  b2_precomp = GF_MulConstPrecomp<T,P> (b2);
+    static constexpr T b3 = RaderConst<T,P> (7, 3, InvNTT, 3),  b3_precomp = GF_MulConstPrecomp<T,P> (b3);
+    static constexpr T b4 = RaderConst<T,P> (7, 3, InvNTT, 4),  b4_precomp = GF_MulConstPrecomp<T,P> (b4);
+    static constexpr T b5 = RaderConst<T,P> (7, 3, InvNTT, 5),  b5_precomp = GF_MulConstPrecomp<T,P> (b5);
+
+    T x0 = f0;
+    NTT6<T,P,false> (f1, f3, f2, f6, f4, f5);
+    f0 = GF_Add<T,P> (x0, f1);
+
+    f1 = GF_MulConst<T,P> (f1, b0, b0_precomp);
+    f3 = GF_MulConst<T,P> (f3, b1, b1_precomp);
+    f2 = GF_MulConst<T,P> (f2, b2, b2_precomp);
+    f6 = GF_MulConst<T,P> (f6, b3, b3_precomp);
+    f4 = GF_MulConst<T,P> (f4, b4, b4_precomp);
+    f5 = GF_MulConst<T,P> (f5, b5, b5_precomp);
+    f1 = GF_Add<T,P> (f1, x0);
+
+    NTT6<T,P,false> (f1, f3, f2, f6, f4, f5);
+}
+
+
 // Perform a single order-9 NTT
 template <typename T, T P, bool InvNTT>
 __forceinline void NTT9 (T& __restrict__ f0, T& __restrict__ f1, T& __restrict__ f2,
@@ -120,6 +190,9 @@ __forceinline void NTT9 (T& __restrict__ f0, T& __restrict__ f1, T& __restrict__
     static constexpr T root1 = InvNTT? GF_Inv<T,P>(root) : root;
     static constexpr T root2 = GF_Mul <T,P> (root1, root1);
     static constexpr T root4 = GF_Mul <T,P> (root2, root2);
+    static constexpr T root1_precomp = GF_MulConstPrecomp<T,P> (root1);
+    static constexpr T root2_precomp = GF_MulConstPrecomp<T,P> (root2);
+    static constexpr T root4_precomp = GF_MulConstPrecomp<T,P> (root4);
 
     // 4-step MFA on 3x3 matrix:
 
@@ -129,10 +202,10 @@ __forceinline void NTT9 (T& __restrict__ f0, T& __restrict__ f1, T& __restrict__
     NTT3<T,P,InvNTT> (f2, f5, f8);
 
     // 2. Multiply by twiddle factors
-    f4 = GF_Mul<T,P> (f4, root1);
-    f5 = GF_Mul<T,P> (f5, root2);
-    f7 = GF_Mul<T,P> (f7, root2);
-    f8 = GF_Mul<T,P> (f8, root4);
+    f4 = GF_MulConst<T,P> (f4, root1, root1_precomp);
+    f5 = GF_MulConst<T,P> (f5, root2, root2_precomp);
+    f7 = GF_MulConst<T,P> (f7, root2, root2_precomp);
+    f8 = GF_MulConst<T,P> (f8, root4, root4_precomp);
 
     // 3. NTT(3) on columns
     NTT3<T,P,InvNTT> (f0, f1, f2);
@@ -146,13 +219,185 @@ __forceinline void NTT9 (T& __restrict__ f0, T& __restrict__ f1, T& __restrict__
 }
 
 
+// Perform a single order-12 NTT: prime-factor algorithm with input i = 4*i1 + 3*i2 mod 12.
+// Order-4 NTTs employ the inverse root in order to produce output in the natural order
+template <typename T, T P, bool InvNTT>
+__forceinline void NTT12 (T& __restrict__ f0, T& __restrict__ f1, T& __restrict__ f2,  T& __restrict__ f3,
+                          T& __restrict__ f4, T& __restrict__ f5, T& __restrict__ f6,  T& __restrict__ f7,
+                          T& __restrict__ f8, T& __restrict__ f9, T& __restrict__ f10, T& __restrict__ f11)
+{
+    NTT3<T,P,InvNTT> (f0, f4,  f8);
+    NTT3<T,P,InvNTT> (f3, f7,  f11);
+    NTT3<T,P,InvNTT> (f6, f10, f2);
+    NTT3<T,P,InvNTT> (f9, f1,  f5);
+
+    NTT4<T,P,!InvNTT> (f0, f3,  f6,  f9);
+    NTT4<T,P,!InvNTT> (f4, f7,  f10, f1);
+    NTT4<T,P,!InvNTT> (f8, f11, f2,  f5);
+}
+
+
+// Perform a single order-13 NTT: Rader's algorithm with g=2, i.e. inputs and outputs ordered as f1,f2,f4,f8,f3,f6,f12,f11,f9,f5,f10,f7
+template <typename T, T P, bool InvNTT>
+__forceinline void NTT13 (T& __restrict__ f0, T& __restrict__ f1, T& __restrict__ f2,  T& __restrict__ f3,  T& __restrict__ f4,
+                          T& __restrict__ f5, T& __restrict__ f6, T& __restrict__ f7,  T& __restrict__ f8,  T& __restrict__ f9,
+                          T& __restrict__ f10, T& __restrict__ f11, T& __restrict__ f12)
+{
+    static constexpr T b0  = RaderConst<T,P> (13, 2, InvNTT, 0),   b0_precomp  = GF_MulConstPrecomp<T,P> (b0);
+    static constexpr T b1  = RaderConst<T,P> (13, 2, InvNTT, 1),   b1_precomp  = GF_MulConstPrecomp<T,P> (b1);
+    static constexpr T b2  = RaderConst<T,P> (13, 2, InvNTT, 2),   b2_precomp  = GF_MulConstPrecomp<T,P> (b2);
+    static constexpr T b3  = RaderConst<T,P> (13, 2, InvNTT, 3),   b3_precomp  = GF_MulConstPrecomp<T,P> (b3);
+    static constexpr T b4  = RaderConst<T,P> (13, 2, InvNTT, 4),   b4_precomp  = GF_MulConstPrecomp<T,P> (b4);
+    static constexpr T b5  = RaderConst<T,P> (13, 2, InvNTT, 5),   b5_precomp  = GF_MulConstPrecomp<T,P> (b5);
+    static constexpr T b6  = RaderConst<T,P> (13, 2, InvNTT, 6),   b6_precomp  = GF_MulConstPrecomp<T,P> (b6);
+    static constexpr T b7  = RaderConst<T,P> (13, 2, InvNTT, 7),   b7_precomp  = GF_MulConstPrecomp<T,P> (b7);
+    static constexpr T b8  = RaderConst<T,P> (13, 2, InvNTT, 8),   b8_precomp  = GF_MulConstPrecomp<T,P> (b8);
+    static constexpr T b9  = RaderConst<T,P> (13, 2, InvNTT, 9),   b9_precomp  = GF_MulConstPrecomp<T,P> (b9);
+    static constexpr T b10 = RaderConst<T,P> (13, 2, InvNTT, 10),  b10_precomp = GF_MulConstPrecomp<T,P> (b10);
+    static constexpr T b11 = RaderConst<T,P> (13, 2, InvNTT, 11),  b11_precomp = GF_MulConstPrecomp<T,P> (b11);
+
+    T x0 = f0;
+    NTT12<T,P,false> (f1, f2, f4, f8, f3, f6, f12, f11, f9, f5, f10, f7);
+    f0 = GF_Add<T,P> (x0, f1);
+
+    f1  = GF_MulConst<T,P> (f1,  b0,  b0_precomp);
+    f2  = GF_MulConst<T,P> (f2,  b1,  b1_precomp);
+    f4  = GF_MulConst<T,P> (f4,  b2,  b2_precomp);
+    f8  = GF_MulConst<T,P> (f8,  b3,  b3_precomp);
+    f3  = GF_MulConst<T,P> (f3,  b4,  b4_precomp);
+    f6  = GF_MulConst<T,P> (f6,  b5,  b5_precomp);
+    f12 = GF_MulConst<T,P> (f12, b6,  b6_precomp);
+    f11 = GF_MulConst<T,P> (f11, b7,  b7_precomp);
+    f9  = GF_MulConst<T,P> (f9,  b8,  b8_precomp);
+    f5  = GF_MulConst<T,P> (f5,  b9,  b9_precomp);
+    f10 = GF_MulConst<T,P> (f10, b10, b10_precomp);
+    f7  = GF_MulConst<T,P> (f7,  b11, b11_precomp);
+    f1  = GF_Add<T,P> (f1, x0);
+
+    NTT12<T,P,false> (f1, f2, f4, f8, f3, f6, f12, f11, f9, f5, f10, f7);
+}
+
+
+// Perform order-2 NTT on each pair of elements of two blocks, employing the vectorized kernel if available (see GF_SIMD.cpp)
+template <typename T, T P>
+void NTT2 (T* __restrict__ block1, T* __restrict__ block2, size_t SIZE)
+{
+    if (GF_Kernels<T,P>::enabled)  {GF_Kernels<T,P>::Butterfly1 (block1, block2, SIZE);  return;}
+    for (size_t k=0; k<SIZE; k++)             // cycle over SIZE elements of the single block
+        NTT2<T,P> (block1[k], block2[k]);
+}
+
+
+// The same, but with twiddle factor applied to the second block, i.e. the NTT butterfly
+template <typename T, T P>
+void NTT2 (T* __restrict__ block1, T* __restrict__ block2, size_t SIZE, T root, T root_precomp)
+{
+    if (GF_Kernels<T,P>::enabled)  {GF_Kernels<T,P>::Butterfly (block1, block2, SIZE, root, root_precomp);  return;}
+    for (size_t k=0; k<SIZE; k++)             // cycle over SIZE elements of the single block
+        NTT2<T,P> (block1[k], block2[k], root, root_precomp);
+}
+
+
+// Multiply each element of the block by the constant, employing the vectorized kernel if available.
+// Like the NTT2, it produces lazy-reduced results for the GF_Lazy fields
+template <typename T, T P>
+void GF_MulConst (T* dst, const T* src, size_t SIZE, T root, T root_precomp)
+{
+    if (GF_Kernels<T,P>::enabled)  {GF_Kernels<T,P>::Scale (dst, src, SIZE, root, root_precomp);  return;}
+    for (size_t k=0; k<SIZE; k++)             // cycle over SIZE elements of the single block
+        dst[k] = GF_Lazy<T,P>::enabled?  GF_MulConstLazy<T,P> (src[k], root, root_precomp)
+                                      :  GF_MulConst<T,P>     (src[k], root, root_precomp);
+}
+
+
+// Normalize each element of the block (see GF_Normalize), the loop is vectorized by the compiler
+template <typename T, T P>
+void GF_Normalize (T* __restrict__ block, size_t SIZE)
+{
+    for (size_t k=0; k<SIZE; k++)             // cycle over SIZE elements of the single block
+        block[k] = GF_Normalize<T,P> (block[k]);
+}
+
+
+// Convert raw 32-bit words of the block into field elements in place, storing GF_PackMasks(SIZE) masks to masks[],
+// and back with the same masks (see PackBlock in GF_SIMD.cpp). GF_UnpackBlock also packs the block again with known masks
+template <typename T, T P>
+void GF_PackBlock (T* block, size_t SIZE, uint16_t* masks)
+{
+    assert ((GF_Packable<T,P>()));
+    GF_Kernels<T,P>::Pack (block, SIZE, masks);
+}
+
+template <typename T, T P>
+void GF_UnpackBlock (T* block, size_t SIZE, const uint16_t* masks)
+{
+    assert ((GF_Packable<T,P>()));
+    GF_Kernels<T,P>::Unpack (block, SIZE, masks);
+}
+
+
+// Perform R successive NTT steps on 2**R blocks x[], employing the vectorized Radix4/Radix8 kernel if available.
+// Step l combines blocks j and j+2**l (where bit l of j is zero) with the twiddle factor root[2**l-1 + j%2**l].
+// Each element is loaded and stored only once, instead of once per step
+template <typename T, T P, int R>
+void NTT2_Radix (T** x, size_t SIZE, const T* root, const T* root_precomp)
+{
+    if (GF_Kernels<T,P>::enabled)  {(R==2? GF_Kernels<T,P>::Radix4 : GF_Kernels<T,P>::Radix8) (x, SIZE, root, root_precomp);  return;}
+    const T *w = root,  *wp = root_precomp;
+    if (R == 2) {
+        for (size_t k=0; k<SIZE; k++) {           // cycle over SIZE elements of the single block
+            T f0 = x[0][k],  f1 = x[1][k],  f2 = x[2][k],  f3 = x[3][k];
+            NTT2<T,P> (f0, f1, w[0], wp[0]);   NTT2<T,P> (f2, f3, w[0], wp[0]);
+            NTT2<T,P> (f0, f2, w[1], wp[1]);   NTT2<T,P> (f1, f3, w[2], wp[2]);
+            x[0][k] = f0,  x[1][k] = f1,  x[2][k] = f2,  x[3][k] = f3;
+        }
+    } else {
+        for (size_t k=0; k<SIZE; k++) {
+            T f0 = x[0][k],  f1 = x[1][k],  f2 = x[2][k],  f3 = x[3][k],  f4 = x[4][k],  f5 = x[5][k],  f6 = x[6][k],  f7 = x[7][k];
+            NTT2<T,P> (f0, f1, w[0], wp[0]);   NTT2<T,P> (f2, f3, w[0], wp[0]);   NTT2<T,P> (f4, f5, w[0], wp[0]);   NTT2<T,P> (f6, f7, w[0], wp[0]);
+            NTT2<T,P> (f0, f2, w[1], wp[1]);   NTT2<T,P> (f1, f3, w[2], wp[2]);   NTT2<T,P> (f4, f6, w[1], wp[1]);   NTT2<T,P> (f5, f7, w[2], wp[2]);
+            NTT2<T,P> (f0, f4, w[3], wp[3]);   NTT2<T,P> (f1, f5, w[4], wp[4]);   NTT2<T,P> (f2, f6, w[5], wp[5]);   NTT2<T,P> (f3, f7, w[6], wp[6]);
+            x[0][k] = f0,  x[1][k] = f1,  x[2][k] = f2,  x[3][k] = f3,  x[4][k] = f4,  x[5][k] = f5,  x[6][k] = f6,  x[7][k] = f7;
+        }
+    }
+}
+
+
+// Small-block mode. Blocks permuted by the MFA transposes are scattered over memory, and hardware prefetchers can't predict
+// the next block, so each block smaller than ~2 KB starts with cache misses not covered by the computations on the previous one.
+// In this mode, loops prefetch the blocks used by the butterflies PrefetchDistance() steps ahead. FASTECC_PREFETCH overrides the distance, 0 disables
+inline size_t PrefetchDistance (size_t bytes)
+{
+    static int distance = []
+    {
+        const char* env = getenv("FASTECC_PREFETCH");
+        return (env? atoi(env) : -1);
+    }();
+    if (distance >= 0)  return size_t(distance);
+    return (bytes < 2048?  4 : 0);
+}
+
+// Prefetch all cache lines of the block
+template <typename T>
+inline void PrefetchBlock (const T* block, size_t SIZE)
+{
+    const char* ptr = (const char*) block;
+    for (size_t i=0; i<SIZE*sizeof(T); i+=64) {
+#if defined(__GNUC__)
+        __builtin_prefetch (ptr+i);
+#elif defined(GF_SIMD_KERNELS)
+        _mm_prefetch (ptr+i, _MM_HINT_T0);
+#endif
+    }
+}
+
+
 // Perform N order-2 NTTs
 template <typename T, T P>
 void NTT2 (T** data, size_t N, size_t SIZE)
 {
     for (size_t i=0; i<N; i++)
-        for (size_t k=0; k<SIZE; k++)         // cycle over SIZE elements of the single block
-            NTT2<T,P> (data[i][k], data[i+N][k]);
+        NTT2<T,P> (data[i], data[i+N], SIZE);
 }
 
 
@@ -160,9 +405,10 @@ void NTT2 (T** data, size_t N, size_t SIZE)
 template <typename T, T P, bool InvNTT>
 void NTT3 (T** data, size_t N, size_t SIZE)
 {
-    for (size_t i=0; i<N; i++)
+    ParallelFor (0, N, [&] (ptrdiff_t i) {
         for (size_t k=0; k<SIZE; k++)         // cycle over SIZE elements of the single block
             NTT3<T,P,InvNTT> (data[i][k], data[i+N][k], data[i+2*N][k]);
+    });
 }
 
 
@@ -170,9 +416,10 @@ void NTT3 (T** data, size_t N, size_t SIZE)
 template <typename T, T P, bool InvNTT>
 void NTT4 (T** data, size_t N, size_t SIZE)
 {
-    for (size_t i=0; i<N; i++)
+    ParallelFor (0, N, [&] (ptrdiff_t i) {
         for (size_t k=0; k<SIZE; k++)         // cycle over SIZE elements of the single block
             NTT4<T,P,InvNTT> (data[i][k], data[i+N][k], data[i+2*N][k], data[i+3*N][k]);
+    });
 }
 
 
@@ -180,9 +427,10 @@ void NTT4 (T** data, size_t N, size_t SIZE)
 template <typename T, T P, bool InvNTT>
 void NTT5 (T** data, size_t N, size_t SIZE)
 {
-    for (size_t i=0; i<N; i++)
+    ParallelFor (0, N, [&] (ptrdiff_t i) {
         for (size_t k=0; k<SIZE; k++)         // cycle over SIZE elements of the single block
             NTT5<T,P,InvNTT> (data[i][k], data[i+N][k], data[i+2*N][k], data[i+3*N][k], data[i+4*N][k]);
+    });
 }
 
 
@@ -190,10 +438,23 @@ void NTT5 (T** data, size_t N, size_t SIZE)
 template <typename T, T P, bool InvNTT>
 void NTT6 (T** data, size_t N, size_t SIZE)
 {
-    for (size_t i=0; i<N; i++)
+    ParallelFor (0, N, [&] (ptrdiff_t i) {
         for (size_t k=0; k<SIZE; k++)         // cycle over SIZE elements of the single block
             NTT6<T,P,InvNTT> (data[i    ][k], data[i+  N][k], data[i+2*N][k],
                               data[i+3*N][k], data[i+4*N][k], data[i+5*N][k]);
+    });
+}
+
+
+// Perform N order-7 NTTs
+template <typename T, T P, bool InvNTT>
+void NTT7 (T** data, size_t N, size_t SIZE)
+{
+    ParallelFor (0, N, [&] (ptrdiff_t i) {
+        for (size_t k=0; k<SIZE; k++)         // cycle over SIZE elements of the single block
+            NTT7<T,P,InvNTT> (data[i    ][k], data[i+  N][k], data[i+2*N][k], data[i+3*N][k],
+                              data[i+4*N][k], data[i+5*N][k], data[i+6*N][k]);
+    });
 }
 
 
@@ -201,83 +462,345 @@ void NTT6 (T** data, size_t N, size_t SIZE)
 template <typename T, T P, bool InvNTT>
 void NTT9 (T** data, size_t N, size_t SIZE)
 {
-    for (size_t i=0; i<N; i++)
+    ParallelFor (0, N, [&] (ptrdiff_t i) {
         for (size_t k=0; k<SIZE; k++)         // cycle over SIZE elements of the single block
             NTT9<T,P,InvNTT> (data[i    ][k], data[i+  N][k], data[i+2*N][k],
                               data[i+3*N][k], data[i+4*N][k], data[i+5*N][k],
                               data[i+6*N][k], data[i+7*N][k], data[i+8*N][k]);
+    });
+}
+
+
+// Perform N order-12 NTTs
+template <typename T, T P, bool InvNTT>
+void NTT12 (T** data, size_t N, size_t SIZE)
+{
+    ParallelFor (0, N, [&] (ptrdiff_t i) {
+        for (size_t k=0; k<SIZE; k++)         // cycle over SIZE elements of the single block
+            NTT12<T,P,InvNTT> (data[i    ][k], data[i+  N][k], data[i+ 2*N][k], data[i+ 3*N][k],
+                               data[i+4*N][k], data[i+5*N][k], data[i+ 6*N][k], data[i+ 7*N][k],
+                               data[i+8*N][k], data[i+9*N][k], data[i+10*N][k], data[i+11*N][k]);
+    });
+}
+
+
+// Perform N order-13 NTTs
+template <typename T, T P, bool InvNTT>
+void NTT13 (T** data, size_t N, size_t SIZE)
+{
+    ParallelFor (0, N, [&] (ptrdiff_t i) {
+        for (size_t k=0; k<SIZE; k++)         // cycle over SIZE elements of the single block
+            NTT13<T,P,InvNTT> (data[i    ][k], data[i+  N][k], data[i+ 2*N][k], data[i+ 3*N][k], data[i+ 4*N][k],
+                               data[i+5*N][k], data[i+6*N][k], data[i+ 7*N][k], data[i+ 8*N][k], data[i+ 9*N][k],
+                               data[i+10*N][k], data[i+11*N][k], data[i+12*N][k]);
+    });
+}
+
+
+// Perform N order-n NTTs, dispatching to the codelet of the requested order
+template <typename T, T P, bool InvNTT>
+void SmallNTT (T** data, size_t n, size_t N, size_t SIZE)
+{
+    switch (n) {
+        case 2:  NTT2 <T,P>        (data, N, SIZE);  break;
+        case 3:  NTT3 <T,P,InvNTT> (data, N, SIZE);  break;
+        case 4:  NTT4 <T,P,InvNTT> (data, N, SIZE);  break;
+        case 5:  NTT5 <T,P,InvNTT> (data, N, SIZE);  break;
+        case 6:  NTT6 <T,P,InvNTT> (data, N, SIZE);  break;
+        case 7:  NTT7 <T,P,InvNTT> (data, N, SIZE);  break;
+        case 9:  NTT9 <T,P,InvNTT> (data, N, SIZE);  break;
+        case 12: NTT12<T,P,InvNTT> (data, N, SIZE);  break;
+        case 13: NTT13<T,P,InvNTT> (data, N, SIZE);  break;
+        default: assert (!"unsupported codelet order");
+    }
+}
+
+
+/***********************************************************************************************************************
+*** NTT plan ***********************************************************************************************************
+************************************************************************************************************************/
+
+// Precomputed data for NTTs of orders 2**X up to N, that can be reused by any number of transforms.
+// roots[InvNTT][n+i] holds root(n)**i for each n=1,2,4..N and i<n (inverse roots for InvNTT==true), so the NTT steps
+// combining order-n/2 transforms load their twiddle factors from roots+n, and the order-n MFA takes its twiddle factors from the same place.
+// precomp[InvNTT][n+i] holds the same roots prepared for GF_MulConst.
+// scratch[] is the memory for TransposeMatrix, borrowed by one transform at a time (see TransposeScratch).
+// kernel selects the transform performed on the sub-transforms that fit into the cache
+enum NTTKernel {ITERATIVE_KERNEL, STOCKHAM_KERNEL};
+
+template <typename T, T P>
+struct NTTPlan
+{
+    size_t N;                   // maximum NTT order supported by the plan
+    std::vector<T> roots[2];    // twiddle factors for the forward and inverse NTT
+    std::vector<T> precomp[2];  // GF_MulConstPrecomp(roots[InvNTT][i])
+    mutable std::vector<T*> scratch;        // N block pointers
+    mutable std::atomic_flag scratch_busy;  // set while scratch[] is used by some transform
+    bool stockham;              // use StockhamNTT instead of IterativeNTT for sub-transforms that fit into the cache
+    size_t radix;               // 2, 4 or 8: number of blocks combined by a single pass of IterativeNTT_Steps and RecursiveNTT_Steps
+
+    NTTPlan (size_t _N, NTTKernel kernel = ITERATIVE_KERNEL) : N(_N), scratch(_N)
+    {
+        scratch_busy.clear();
+        stockham = (kernel == STOCKHAM_KERNEL);
+        const char* env_radix = getenv("FASTECC_RADIX");
+        radix = (env_radix? atoi(env_radix) : 8);
+        radix = (radix >= 8? 8 : radix >= 4? 4 : 2);
+        for (int InvNTT=0; InvNTT<2; InvNTT++) {
+            std::vector<T>& r = roots[InvNTT];
+            r.resize(2*N);
+
+            // Powers of the primary root of order N
+            T root = GF_Root<T,P>(N),  root_i = 1;
+            if (InvNTT)  root = GF_Inv<T,P>(root);
+            for (size_t i=0; i<N; i++) {
+                r[N+i] = root_i;
+                root_i = GF_Mul<T,P> (root_i, root);
+            }
+
+            // Roots of smaller orders are just every second root of the next order
+            for (size_t n=N/2; n>=1; n/=2)
+                for (size_t i=0; i<n; i++)
+                    r[n+i] = r[2*n+2*i];
+
+            precomp[InvNTT].resize(2*N);
+            for (size_t i=0; i<2*N; i++)
+                precomp[InvNTT][i] = GF_MulConstPrecomp<T,P> (r[i]);
+        }
+    }
+
+    // Twiddle factors for the forward or inverse NTT
+    const T* Roots   (bool InvNTT) const  {return roots[InvNTT].data();}
+    const T* Precomp (bool InvNTT) const  {return precomp[InvNTT].data();}
+};
+
+// Kernel requested for the benchmarks by the FASTECC_KERNEL environment variable: "iterative" (default) or "stockham"
+inline NTTKernel BenchKernel()
+{
+    const char* env = getenv("FASTECC_KERNEL");
+    return (env && strcmp (env, "stockham") == 0?  STOCKHAM_KERNEL : ITERATIVE_KERNEL);
 }
 
 
+// Scale factors of the input or output blocks of a transform: block j is multiplied by factor*scale[j*stride],
+// or just by the factor if scale==0. The default object leaves the data intact. Transforms apply them in their first or last step,
+// while the blocks are in the cache, so the scaling doesn't need a separate pass over the data.
+// The conversion is merged into the same pass: PACK converts raw input words into field elements before scaling,
+// storing the masks of block j to masks[j*stride*GF_PackMasks(SIZE)...] (see GF_PackBlock),
+// and NORMALIZE normalizes the scaled outputs of the fields listed by GF_Unnormalized
+template <typename T, T P>
+struct BlockScale
+{
+    enum Conversion {NONE, NORMALIZE, PACK};
+
+    const T* scale;
+    T factor;
+    size_t stride;
+    Conversion conversion;
+    uint16_t* masks;
+    size_t first;       // block j has the index first+j*stride in the masks[]
+
+    BlockScale (const T* _scale = 0,  T _factor = 1,  size_t _stride = 1,  Conversion _conversion = NONE,  uint16_t* _masks = 0,  size_t _first = 0)
+        : scale(_scale), factor(_factor), stride(_stride), conversion(_conversion), masks(_masks), first(_first)  {}
+
+    bool Empty() const  {return scale==0 && factor==1 && (conversion==NONE || (conversion==NORMALIZE && !GF_Unnormalized<T,P>()));}
+    T operator[] (size_t j) const  {return scale? GF_Mul<T,P> (factor, scale[j*stride]) : factor;}
+
+    // Scale factors of the blocks i, i+step, i+2*step... i.e. of a row or column of the MFA matrix
+    BlockScale Sub (size_t i, size_t step) const
+    {
+        return BlockScale (scale? scale + i*stride : 0,  factor,  stride*step,  conversion,  masks,  first + i*stride);
+    }
+
+    // Convert the input block j before it's used by the transform. Steps that merge the scale factor of the block into
+    // their butterflies call Prepare() instead of Apply()
+    void Prepare (T* block, size_t j, size_t SIZE) const
+    {
+        if (conversion == PACK)
+            GF_PackBlock<T,P> (block, SIZE, masks + (first + j*stride) * GF_PackMasks(SIZE));
+    }
+
+    // Multiply the block j by its scale factor, without the conversion
+    void Multiply (T* block, size_t j, size_t SIZE) const
+    {
+        if (scale || factor != 1) {
+            T w = (*this)[j];
+            GF_MulConst<T,P> (block, block, SIZE, w, GF_MulConstPrecomp<T,P> (w));
+        }
+    }
+
+    // Multiply the block j by its scale factor, with the conversion
+    void Apply (T* block, size_t j, size_t SIZE) const
+    {
+        Prepare (block, j, SIZE);
+        Multiply (block, j, SIZE);
+        if (conversion == NORMALIZE  &&  GF_Unnormalized<T,P>())
+            GF_Normalize<T,P> (block, SIZE);
+    }
+};
+
+
 /***********************************************************************************************************************
 *** NTT steps **********************************************************************************************************
 ************************************************************************************************************************/
 
-// Recursive NTT implementation
+// Perform steps Ns, 2*Ns .. Ns*2**(R-1) on the group of 2**R blocks data[i+j*Ns], i<Ns, with a single NTT2_Radix pass
 template <typename T, T P>
-void RecursiveNTT_Steps (T** data, size_t FirstN, size_t N, size_t SIZE, T* roots)
+void NTT2_Group (T** data, size_t Ns, int R, size_t i, size_t SIZE, const T* roots, const T* precomp)
 {
-    N /= 2;
-    if (N >= FirstN) {
-#if _OPENMP>=200805
-        #pragma omp task if (N>16384)
-#endif
-        RecursiveNTT_Steps<T,P> (data,   FirstN, N, SIZE, roots+1);
-#if _OPENMP>=200805
-        #pragma omp task if (N>16384)
-#endif
-        RecursiveNTT_Steps<T,P> (data+N, FirstN, N, SIZE, roots+1);
-#if _OPENMP>=200805
-        #pragma omp taskwait
-#endif
+    T* x[8];
+    T root[7], root_precomp[7];
+    for (int j=0; j < (1<<R); j++)
+        x[j] = data[i + j*Ns];
+    for (int l=0; l<R; l++) {
+        for (size_t low=0; low < (size_t(1)<<l); low++) {       // step l employs root(Ns*2**(l+1))**(i + low*Ns)
+            size_t t = (size_t(1)<<l) - 1 + low,  n = Ns << (l+1);
+            root[t] = roots[n + i + low*Ns],  root_precomp[t] = precomp[n + i + low*Ns];
+        }
     }
+    if (R == 3)  NTT2_Radix<T,P,3> (x, SIZE, root, root_precomp);
+    else         NTT2_Radix<T,P,2> (x, SIZE, root, root_precomp);
+}
 
-    T root = *roots,   root_i = 1;                      // zeroth root of power 2N of 1
-    for (size_t i=0; i<N; i++) {
-        T* __restrict__ block1 = data[i];
-        T* __restrict__ block2 = data[i+N];
-        for (size_t k=0; k<SIZE; k++) {                 // cycle over SIZE elements of the single block
-            T u       = block1[k];
-            T v       = GF_Mul<T,P> (block2[k], root_i);
-            block1[k] = GF_Add<T,P> (u,v);
-            block2[k] = GF_Sub<T,P> (u,v);
+
+// Recursive NTT implementation. Each call combines 2**R sub-transforms of order N/2**R, where R is limited by the Radix (2, 4 or 8)
+// and by the number of steps remaining for this call: they are N/2, N/4 .. FirstN/2
+template <typename T, T P>
+void RecursiveNTT_Steps (T** data, size_t FirstN, size_t N, size_t SIZE, const T* roots, const T* precomp, size_t Radix = 2)
+{
+    int R = 1;
+    while ((size_t(2) << R) <= Radix  &&  (N >> R) >= FirstN)
+        R++;
+    size_t M = N >> R;              // order of sub-transforms
+    if (M >= FirstN) {
+        if (M > 16384) {
+            // Large sub-transforms are executed as tasks, so idle threads can steal them
+            TaskGroup tasks;
+            for (size_t j=0; j < (size_t(1)<<R); j++)
+                tasks.Run ([=]{RecursiveNTT_Steps<T,P> (data + j*M, FirstN, M, SIZE, roots, precomp, Radix);});
+            tasks.Wait();
+        } else {
+            for (size_t j=0; j < (size_t(1)<<R); j++)
+                RecursiveNTT_Steps<T,P> (data + j*M, FirstN, M, SIZE, roots, precomp, Radix);
         }
-        root_i = GF_Mul<T,P> (root_i, root);            // next root of power 2N of 1
     }
+
+    if (R > 1) {
+        for (size_t i=0; i<M; i++)
+            NTT2_Group<T,P> (data, M, R, i, SIZE, roots, precomp);
+        return;
+    }
+    const T* root = roots + 2*M;                        // root[i] = i-th root of power 2M of 1
+    const T* root_precomp = precomp + 2*M;
+    for (size_t i=0; i<M; i++)
+        NTT2<T,P> (data[i], data[i+M], SIZE, root[i], root_precomp[i]);
+}
+
+
+// Reverse order of the lower logb(N) bits of x
+inline size_t revbin (size_t x, size_t N)
+{
+    size_t r = 0;
+    for (size_t n=N; n>1; n/=2, x/=2)
+        r = 2*r + (x&1);
+    return r;
 }
 
 
-// Iterative NTT implementation
+// Iterative NTT implementation.
+// Input-pruned transform: only the first NonZero inputs of the whole order-LastN NTT are non-zero.
+// After revbin_permute, the group of n blocks starting at x holds inputs revbin(x)+j*LastN/n, so it's all zero when revbin(x)>=NonZero.
+// Such groups are never read, and when only the second half of the group is zero, the butterflies just copy the first half into it.
+// With Radix 4 or 8, up to 2 or 3 steps are fused into a single pass over the data, unless the transform is input-pruned.
+// Fused passes only pay off when the data don't fit into L2 cache: otherwise the simpler radix-2 butterflies are faster.
+// When the steps perform the whole transform (FirstN==1), the first step multiplies input j by in_scale[j],
+// and the last step multiplies output j by out_scale[j] (see BlockScale).
 template <typename T, T P>
-void IterativeNTT_Steps (T** data, size_t FirstN, size_t LastN, size_t SIZE, T* root_ptr)
+void IterativeNTT_Steps (T** data, size_t FirstN, size_t LastN, size_t SIZE, const T* roots, const T* precomp,
+                         size_t NonZero = size_t(-1),  size_t Radix = 2,
+                         const BlockScale<T,P>& in_scale = BlockScale<T,P>(),  const BlockScale<T,P>& out_scale = BlockScale<T,P>())
 {
-    for (size_t N=FirstN; N<LastN; N*=2)
+    if (uint64_t(LastN)*SIZE*sizeof(T) <= L2Cache())
+        Radix = 2;
+    size_t D = PrefetchDistance (SIZE*sizeof(T));               // prefetch the butterfly x+i+D
+    size_t N = FirstN;
+
+    if (FirstN == 1  &&  LastN > 1  &&  !in_scale.Empty()) {
+        // The first step with input scaling: the first block of each pair is scaled alone,
+        // while the scale factor of the second block becomes the twiddle factor of the butterfly
+        bool last = (LastN == 2  &&  !out_scale.Empty());
+        for (size_t x=0; x<LastN; x+=2) {
+            size_t j0 = revbin(x,LastN),  j1 = revbin(x+1,LastN);     // inputs held by the pair
+            if (j0 >= NonZero)                                      // both inputs are zero
+                continue;
+            in_scale.Apply (data[x], j0, SIZE);
+            if (j1 >= NonZero) {
+                memcpy (data[x+1], data[x], SIZE*sizeof(T));
+            } else {
+                T w = in_scale[j1];
+                in_scale.Prepare (data[x+1], j1, SIZE);
+                NTT2<T,P> (data[x], data[x+1], SIZE, w, GF_MulConstPrecomp<T,P> (w));
+            }
+            if (last)  out_scale.Apply (data[x], x, SIZE),  out_scale.Apply (data[x+1], x+1, SIZE);
+        }
+        N = 2;
+    }
+
+    for (; N<LastN; N*=2)
     {
-        T root = *--root_ptr;
+        int R = 1;
+        while ((size_t(2) << R) <= Radix  &&  (N << R) < LastN  &&  NonZero >= LastN)
+            R++;
+        if (R > 1) {
+            // Fused pass performing steps N .. N*2**(R-1) on groups of 2**R blocks
+            bool last = ((N << R) == LastN  &&  !out_scale.Empty());
+            for (size_t x=0; x<LastN; x += N<<R) {
+                for (size_t i=0; i<N; i++) {
+                    if (D && i+D < N)
+                        for (size_t j=0; j < (size_t(1)<<R); j++)
+                            PrefetchBlock (data[x+i+D+j*N], SIZE);
+                    NTT2_Group<T,P> (data+x, N, R, i, SIZE, roots, precomp);
+                    if (last)
+                        for (size_t j=0; j < (size_t(1)<<R); j++)
+                            out_scale.Apply (data[x+i+j*N], x+i+j*N, SIZE);
+                }
+            }
+            N <<= R-1;
+            continue;
+        }
+
+        bool last = (2*N == LastN  &&  !out_scale.Empty());    // the last step also scales the outputs
+        const T* root = roots + 2*N;                            // root[i] = i-th root of power 2N of 1
+        const T* root_precomp = precomp + 2*N;
+        auto prefetch = [&] (size_t x, size_t i)
+        {
+            i += D,  x += (i/N)*2*N,  i %= N;
+            if (x < LastN)  PrefetchBlock (data[x+i], SIZE),  PrefetchBlock (data[x+i+N], SIZE);
+        };
         for (size_t x=0; x<LastN; x+=2*N)
         {
-            // first cycle optimized for root_i==1
-            T* __restrict__ block1 = data[x];
-            T* __restrict__ block2 = data[x+N];
-            for (size_t k=0; k<SIZE; k++) {                     // cycle over SIZE elements of the single block
-                T u       = block1[k];
-                T v       = block2[k];                          // optimized for root_i==1
-                block1[k] = GF_Add<T,P> (u,v);
-                block2[k] = GF_Sub<T,P> (u,v);
+            if (NonZero < LastN) {
+                if (revbin(x,LastN) >= NonZero)                 // both halves are zero
+                    continue;
+                if (revbin(x+N,LastN) >= NonZero) {             // second half is zero
+                    for (size_t i=0; i<N; i++) {
+                        memcpy (data[x+i+N], data[x+i], SIZE*sizeof(T));
+                        if (last)  out_scale.Apply (data[x+i], x+i, SIZE),  out_scale.Apply (data[x+i+N], x+i+N, SIZE);
+                    }
+                    continue;
+                }
             }
 
+            // first cycle optimized for root_i==1
+            if (D)  prefetch (x, 0);
+            NTT2<T,P> (data[x], data[x+N], SIZE);
+            if (last)  out_scale.Apply (data[x], x, SIZE),  out_scale.Apply (data[x+N], x+N, SIZE);
+
             // remaining cycles with root_i!=1
-            T root_i = root;                                    // first root of power 2N of 1
             for (size_t i=1; i<N; i++) {
-                T* __restrict__ block1 = data[x+i];
-                T* __restrict__ block2 = data[x+i+N];
-                for (size_t k=0; k<SIZE; k++) {                 // cycle over SIZE elements of the single block
-                    T u       = block1[k];
-                    T v       = GF_Mul<T,P> (block2[k], root_i);
-                    block1[k] = GF_Add<T,P> (u,v);
-                    block2[k] = GF_Sub<T,P> (u,v);
-                }
-                root_i = GF_Mul<T,P> (root_i, root);            // next root of power 2N of 1
+                if (D)  prefetch (x, i);
+                NTT2<T,P> (data[x+i], data[x+i+N], SIZE, root[i], root_precomp[i]);
+                if (last)  out_scale.Apply (data[x+i], x+i, SIZE),  out_scale.Apply (data[x+i+N], x+i+N, SIZE);
             }
         }
     }
@@ -288,9 +811,9 @@ void IterativeNTT_Steps (T** data, size_t FirstN, size_t LastN, size_t SIZE, T*
 *** Auxiliary NTT procedures *******************************************************************************************
 ************************************************************************************************************************/
 
-/* re-order data */
-template <typename T, T P>
-void revbin_permute (T** data, size_t n)
+/* re-order data: block pointers or scalar values */
+template <typename T, T P, typename Item>
+void revbin_permute (Item* data, size_t n)
 {
     if (n<=2)  return;
     size_t mr = 0; // the reversed 0
@@ -309,141 +832,264 @@ void revbin_permute (T** data, size_t n)
 }
 
 
-// Iterative NTT implementation
+// Iterative NTT implementation, only the first NonZero inputs may be non-zero
 template <typename T, T P>
-void IterativeNTT (T** data, size_t N, size_t SIZE, T* root_ptr)
+void IterativeNTT (T** data, size_t N, size_t SIZE, const T* roots, const T* precomp, size_t NonZero = size_t(-1),  size_t Radix = 2,
+                   const BlockScale<T,P>& in_scale = BlockScale<T,P>(),  const BlockScale<T,P>& out_scale = BlockScale<T,P>())
 {
     revbin_permute<T,P> (data, N);
-    IterativeNTT_Steps<T,P> (data, 1, N, SIZE, root_ptr);
+    IterativeNTT_Steps<T,P> (data, 1, N, SIZE, roots, precomp, NonZero, Radix, in_scale, out_scale);
 }
 
 
-// Transpose matrix R*C (rows*columns) into matrix C*R
+// Iterative NTT of N scalar values stored sequentially in data[], f.e. polynomial coefficients, with normalized results.
+// Unlike the block transforms with SIZE=1, butterflies access the array directly instead of dereferencing a pointer per element
+template <typename T, T P>
+void ScalarNTT (T* data, size_t N, bool InvNTT, const NTTPlan<T,P>& plan)
+{
+    revbin_permute<T,P> (data, N);
+    for (size_t n=1; n<N; n*=2) {
+        const T* root = plan.Roots(InvNTT) + 2*n;               // root[i] = i-th root of power 2n of 1
+        const T* root_precomp = plan.Precomp(InvNTT) + 2*n;
+        for (size_t x=0; x<N; x+=2*n)
+            for (size_t i=0; i<n; i++)
+                NTT2<T,P> (data[x+i], data[x+i+n], root[i], root_precomp[i]);
+    }
+    for (size_t i=0; i<N; i++)
+        data[i] = GF_Normalize<T,P> (data[i]);
+}
+
+
+// Stockham auto-sort NTT: each radix-2 step reads block pointers from one array and writes them to another one in the order
+// required by the next step, ping-ponging between data[] and tmp[] (N pointers of scratch memory). So the output comes in the natural order
+// without the revbin_permute pass. Step Ns combines pairs of order-Ns transforms: butterfly j takes x[j] and x[j+N/2],
+// and stores results to y[(j/Ns)*2*Ns + j%Ns] and the Ns positions later
+template <typename T, T P>
+void StockhamNTT (T** data, size_t N, size_t SIZE, const T* roots, const T* precomp, T** tmp)
+{
+    T **x = data,  **y = tmp;
+    size_t D = PrefetchDistance (SIZE*sizeof(T));
+    for (size_t Ns=1; Ns<N; Ns*=2)
+    {
+        const T* root = roots + 2*Ns;                           // root[i] = i-th root of power 2*Ns of 1
+        const T* root_precomp = precomp + 2*Ns;
+        for (size_t j=0; j<N/2; j++)
+        {
+            if (D && j+D < N/2)  PrefetchBlock (x[j+D], SIZE),  PrefetchBlock (x[j+D+N/2], SIZE);
+            size_t k = j & (Ns-1),  idx = 2*j - k;
+            T *a = x[j],  *b = x[j+N/2];
+            if (k == 0)  NTT2<T,P> (a, b, SIZE);
+            else         NTT2<T,P> (a, b, SIZE, root[k], root_precomp[k]);
+            y[idx] = a,  y[idx+Ns] = b;
+        }
+        std::swap (x, y);
+    }
+    if (x != data)
+        memcpy (data, x, N*sizeof(T*));
+}
+
+
+// Transpose matrix R*C (rows*columns) into matrix C*R.
+// The matrix is processed in TILE*TILE submatrices, so both rows and columns are accessed in cache-friendly way.
+// Square matrix is transposed in-place, otherwise tmp[] should provide R*C elements of scratch memory
 template <typename T>
-void TransposeMatrix (T* data, size_t R, size_t C)
+void TransposeMatrix (T* data, size_t R, size_t C, T* tmp)
 {
-    #pragma omp single
+    const size_t TILE = 16;
     if (R==C) {
-        for (int r=0; r<R; r++) {
-            for (size_t c=0; c<r; c++) {
-                std::swap (data[r*C+c], data[c*R+r]);
+        // Swap tiles (r0,c0) and (c0,r0) below and above the diagonal, the diagonal tiles are transposed in-place
+        ParallelFor (0, (R+TILE-1)/TILE, [&] (ptrdiff_t t) {
+            size_t r0 = t*TILE,  r1 = std::min (r0+TILE, R);
+            for (size_t c0=0; c0<=r0; c0+=TILE) {
+                for (size_t r=r0; r<r1; r++) {
+                    for (size_t c=c0; c<std::min(c0+TILE,r); c++) {
+                        std::swap (data[r*C+c], data[c*R+r]);
+                    }
+                }
             }
-        }
+        }, 1);
     } else {
-        T* tmp = new T [R*C];  std::unique_ptr<T> _tmp{tmp};
-        for (int r=0; r<R; r++) {
-            for (size_t c=0; c<C; c++) {
-                tmp[c*R+r] = data[r*C+c];
+        size_t RT = (R+TILE-1)/TILE,  CT = (C+TILE-1)/TILE;     // number of tiles along each dimension
+        ParallelFor (0, RT*CT, [&] (ptrdiff_t t) {
+            size_t r0 = (t/CT)*TILE,  r1 = std::min (r0+TILE, R);
+            size_t c0 = (t%CT)*TILE,  c1 = std::min (c0+TILE, C);
+            for (size_t r=r0; r<r1; r++) {
+                for (size_t c=c0; c<c1; c++) {
+                    tmp[c*R+r] = data[r*C+c];
+                }
             }
-        }
-        memcpy (data, tmp, R*C*sizeof(T));
+        });
+
+        const size_t CHUNK = 4096;
+        ParallelFor (0, (R*C+CHUNK-1)/CHUNK, [&] (ptrdiff_t i) {
+            memcpy (data+i*CHUNK, tmp+i*CHUNK, std::min (CHUNK, R*C-i*CHUNK) * sizeof(T));
+        });
     }
 }
 
 
+// Scratch memory of N block pointers for TransposeMatrix, borrowed from the plan for the lifetime of this object.
+// When the plan's buffer is already used by another transform running concurrently, or it's too small, own buffer is allocated
+template <typename T, T P>
+struct TransposeScratch
+{
+    const NTTPlan<T,P>& plan;
+    bool borrowed;
+    std::vector<T*> own;
+    T** ptr;
+
+    TransposeScratch (const NTTPlan<T,P>& _plan, size_t N) : plan(_plan)
+    {
+        borrowed = (N <= plan.N  &&  !plan.scratch_busy.test_and_set());
+        if (!borrowed)  own.resize(N);
+        ptr = (borrowed? plan.scratch.data() : own.data());
+    }
+    ~TransposeScratch()  {if (borrowed)  plan.scratch_busy.clear();}
+};
+
+
 /***********************************************************************************************************************
 *** Three NTT implementations ******************************************************************************************
 ************************************************************************************************************************/
 
-// GF(P) NTT of N==2**X points of type T. Each point represented by SIZE elements (sequential in memory), so we perform SIZE transforms simultaneously
+// Sub-transform performed in the cache: StockhamNTT if the plan asks for it, or IterativeNTT that also supports the input pruning.
+// tmp[] provides N pointers of scratch memory for the StockhamNTT.
+// Input j is multiplied by in_scale[j] and output j by out_scale[j]. IterativeNTT merges them into its first and last steps,
+// while other transforms scale the blocks by separate loops, that are still cheap since the data are in the cache
 template <typename T, T P>
-void Rec_NTT (T** data, size_t N, size_t SIZE, bool InvNTT)
+void CacheNTT (T** data, size_t N, size_t SIZE, bool InvNTT, const NTTPlan<T,P>& plan, size_t NonZero, T** tmp,
+               const BlockScale<T,P>& in_scale = BlockScale<T,P>(),  const BlockScale<T,P>& out_scale = BlockScale<T,P>())
 {
-    // Fill roots[] with roots of 1 of powers N, N/2, ... 2;  root_ptr points after the last entry
-    T root = GF_Root<T,P>(N),  roots[66],  *root_ptr = roots;
-    if (InvNTT)  root = GF_Inv<T,P>(root);
-    while (root != 1) {
-        *root_ptr++ = root;
-        root = GF_Mul<T,P> (root, root);
+    if (NonZero >= N  &&  (N == 1  ||  plan.stockham)) {
+        if (!in_scale.Empty())
+            for (size_t j=0; j<N; j++)
+                in_scale.Apply (data[j], j, SIZE);
+        if (plan.stockham)
+            StockhamNTT<T,P> (data, N, SIZE, plan.Roots(InvNTT), plan.Precomp(InvNTT), tmp);
+        if (!out_scale.Empty())
+            for (size_t j=0; j<N; j++)
+                out_scale.Apply (data[j], j, SIZE);
+        return;
     }
+    IterativeNTT<T,P> (data, N, SIZE, plan.Roots(InvNTT), plan.Precomp(InvNTT), NonZero, plan.radix, in_scale, out_scale);
+}
+
+
+// GF(P) NTT of N==2**X points of type T. Each point represented by SIZE elements (sequential in memory), so we perform SIZE transforms simultaneously
+template <typename T, T P>
+void Rec_NTT (T** data, size_t N, size_t SIZE, bool InvNTT, const NTTPlan<T,P>& plan)
+{
+    assert (N <= plan.N);
+    const T* roots = plan.Roots(InvNTT);
+    const T* precomp = plan.Precomp(InvNTT);
 
     revbin_permute<T,P> (data, N);
 
-    #pragma omp parallel
-    {
-        // Smaller N values up to S are processed iteratively
-#if defined(_OPENMP) && (_OPENMP < 200805)
-        const size_t S = N/16;  // optimized for OpenMP 2.0 - do as much work as possible in the parallelized for loop
-#else
-        const size_t S = 1 << int(logb (99000/(SIZE*sizeof(T)) ));    // otherwise stay in L2 cache (usually at least 256 KB / 2 threads minus memory lost due to only 4/8-associative hashing)
-#endif
-        #pragma omp for
-        for (ptrdiff_t i=0; i<N; i+=S)
-            IterativeNTT_Steps<T,P> (data+i, 1, S, SIZE, root_ptr);
+    // Smaller N values up to S are processed iteratively, staying in L2 cache
+    size_t S;
+    if (!WisdomLookup ("Rec_NTT", P, N, SIZE*sizeof(T), &S))
+        S = size_t(1) << int(logb (std::max (L2Cache()/(SIZE*sizeof(T)), size_t(1)) ));
+    S = std::max (std::min (S, N), size_t(1));
+    ParallelFor (0, N/S, [&] (ptrdiff_t i) {
+        IterativeNTT_Steps<T,P> (data+i*S, 1, S, SIZE, roots, precomp, size_t(-1), plan.radix);
+    }, 1);
+
+    // Larger N values are processed recursively
+    if (S < N)
+        RecursiveNTT_Steps<T,P> (data, 2*S, N, SIZE, roots, precomp, plan.radix);
+}
 
-        // Larger N values are processed recursively
-        #pragma omp master
-        RecursiveNTT_Steps<T,P> (data, 2*S, N, SIZE, roots);
-    }
+template <typename T, T P>
+void Rec_NTT (T** data, size_t N, size_t SIZE, bool InvNTT)
+{
+    NTTPlan<T,P> plan(N);
+    Rec_NTT<T,P> (data, N, SIZE, InvNTT, plan);
 }
 
 
-// The matrix Fourier algorithm (MFA)
+// Number of rows R in the R*C split of the order-N MFA, or 0 if MFA is impossible or will be inefficient.
+// Autotuned value is used when it's present in the wisdom
 template <typename T, T P>
-void MFA_NTT (T** data, size_t N, size_t SIZE, bool InvNTT)
+size_t MFA_Rows (size_t N, size_t SIZE)
 {
-    const size_t L2Cache = 96*1024;  // part of L2 cache owned by each CPU core/thread
+    size_t R;
+    if (WisdomLookup ("MFA_NTT", P, N, SIZE*sizeof(T), &R)  &&  (R == 0  ||  (R >= 2  &&  R <= N/2  &&  (R & (R-1)) == 0)))
+        return R;
+
+    if (N < 4  ||  N*SIZE*sizeof(T) < L2Cache())
+        return 0;
 
     // Split N-size problem into R rows * C columns
-    size_t R = 1;   while (R*R < N)  R*=2;
+    R = 1;   while (R*R < N)  R*=2;
 
     // If subproblems doesn't fit into L2 cache, represent computation as R*C*L cube
-    if (R*SIZE*sizeof(T) > L2Cache) {
+    if (R*SIZE*sizeof(T) > L2Cache()) {
         R = 1;   while (R*R*R < N)  R*=2;
     }
-    size_t C = N/R;
+    return R;
+}
 
-    // Fill roots[] with roots of 1 of powers N, N/2, ... 2;  root_ptr points after the last entry
-    T root = GF_Root<T,P>(N),  roots[66],  *root_ptr = roots;
-    if (InvNTT)  root = GF_Inv<T,P>(root);
-    while (root != 1) {
-        *root_ptr++ = root;
-        root = GF_Mul<T,P> (root, root);
-    }
+
+// The matrix Fourier algorithm (MFA).
+// Input-pruned transform: only the first NonZero inputs are non-zero, and remaining blocks are used only for output, so their
+// initial contents are ignored. Columns having only zero inputs are skipped, and rows get only min(NonZero,C) non-zero inputs.
+// scratch[] provides N block pointers for TransposeMatrix. Input j is multiplied by in_scale[j] and output j by out_scale[j],
+// inside of the column and row sub-transforms respectively (see BlockScale)
+template <typename T, T P>
+void MFA_NTT (T** data, size_t N, size_t SIZE, bool InvNTT, const NTTPlan<T,P>& plan, size_t NonZero, T** scratch,
+              const BlockScale<T,P>& in_scale = BlockScale<T,P>(),  const BlockScale<T,P>& out_scale = BlockScale<T,P>())
+{
+    size_t R = MFA_Rows<T,P> (N, SIZE);
+
+    assert (N <= plan.N);
+    const T* roots = plan.Roots(InvNTT);
+
+    NonZero = std::max (std::min (NonZero, N), size_t(1));
 
     // MFA is impossible or will be inefficient
-    if (N < 4  ||  N*SIZE*sizeof(T) < L2Cache)
+    if (R == 0)
     {
-        IterativeNTT<T,P> (data, N, SIZE, root_ptr);
+        CacheNTT<T,P> (data, N, SIZE, InvNTT, plan, NonZero, scratch, in_scale, out_scale);
         return;
     }
+    size_t C = N/R;
 
 
-    #pragma omp parallel
-    {
-        // 1. Apply a (length R) NTT on each column
-        TransposeMatrix (data, R, C);
-        #pragma omp for
-        for (ptrdiff_t c=0; c<C; c++) {
-            IterativeNTT<T,P> (data+c*R, R, SIZE, root_ptr);
-
-        // 2. Multiply each matrix element (index r,c) by roots[0] ** (r*c)
-            if (c) {
-                T root_c = GF_Pow<T,P> (roots[0], c);
-                T root_rc = root_c;                             // roots[0] ** r
-                for (int r=1; r<R; r++) {
-                    T* __restrict__ block = data[r+c*R];
-                    for (size_t k=0; k<SIZE; k++) {             // cycle over SIZE elements of the single block
-                        block[k] = GF_Mul<T,P> (block[k], root_rc);
-                    }
-                    root_rc = GF_Mul<T,P> (root_rc, root_c);    // roots[0] ** r*c for the next c
-                }
-            }
-        }
-        TransposeMatrix (data, C, R);
-
-        // 3. Apply a (length C) NTT on each row
-        #pragma omp for
-        for (ptrdiff_t i=0; i<N; i+=C) {
-            if (R >= C)  // R rows * C columns
-                IterativeNTT<T,P> (data+i, C, SIZE, root_ptr);
-            else         // R*C*L cube
-                MFA_NTT<T,P> (data+i, C, SIZE, InvNTT);
-        }
+    // 1. Apply a (length R) NTT on each column
+    // 2. Multiply each matrix element (index r,c) by root(N) ** (r*c). It's performed by the last step of the column NTT
+    TransposeMatrix (data, R, C, scratch);
+    ParallelFor (0, std::min (C, NonZero), [&] (ptrdiff_t c) {     // column c holds inputs c, c+C, c+2*C..., so columns c>=NonZero are zero
+        BlockScale<T,P> twiddles (c? roots + N : 0,  1,  c);       // roots[N+i] = root(N) ** i
+        CacheNTT<T,P> (data+c*R, R, SIZE, InvNTT, plan, (NonZero-c+C-1)/C, scratch+c*R, in_scale.Sub(c,C), twiddles);
+    }, 1);
+    TransposeMatrix (data, C, R, scratch);
+
+    // 3. Apply a (length C) NTT on each row. Sub-transforms of the R*C*L cube are split into further tasks.
+    // Output k of the row r becomes the output r+k*R of the entire transform
+    ParallelFor (0, R, [&] (ptrdiff_t r) {
+        size_t i = r*C;
+        if (R >= C)  // R rows * C columns
+            CacheNTT<T,P> (data+i, C, SIZE, InvNTT, plan, NonZero, scratch+i, BlockScale<T,P>(), out_scale.Sub(r,R));
+        else         // R*C*L cube
+            MFA_NTT<T,P> (data+i, C, SIZE, InvNTT, plan, NonZero, scratch+i, BlockScale<T,P>(), out_scale.Sub(r,R));
+    }, 1);
+
+    // 4. Transpose the matrix by transposing block pointers in the data[]
+    TransposeMatrix (data, R, C, scratch);
+}
 
-        // 4. Transpose the matrix by transposing block pointers in the data[]
-        TransposeMatrix (data, R, C);
-    }
+template <typename T, T P>
+void MFA_NTT (T** data, size_t N, size_t SIZE, bool InvNTT, const NTTPlan<T,P>& plan, size_t NonZero = size_t(-1))
+{
+    TransposeScratch<T,P> scratch (plan, N);
+    MFA_NTT<T,P> (data, N, SIZE, InvNTT, plan, NonZero, scratch.ptr);
+}
+
+template <typename T, T P>
+void MFA_NTT (T** data, size_t N, size_t SIZE, bool InvNTT)
+{
+    NTTPlan<T,P> plan(N);
+    MFA_NTT<T,P> (data, N, SIZE, InvNTT, plan);
 }
 
 
@@ -459,8 +1105,7 @@ void Slow_NTT (T* data, size_t N, size_t SIZE, bool InvNTT)
     T dw = 1;
     for (T i=0; i<N; ++i)
     {
-        #pragma omp parallel for
-        for (int k=0; k<SIZE; k++)      // cycle over SIZE elements of the single block
+        ParallelFor (0, SIZE, [&] (ptrdiff_t k)     // cycle over SIZE elements of the single block
         {
             T t = 0;
             T w = 1;
@@ -473,7 +1118,7 @@ void Slow_NTT (T* data, size_t N, size_t SIZE, bool InvNTT)
             }
 
             outdata[i*SIZE+k] = t;
-        }
+        });
 
         dw = GF_Mul<T,P> (dw, root);    // next root of power N
     }
@@ -483,16 +1128,237 @@ void Slow_NTT (T* data, size_t N, size_t SIZE, bool InvNTT)
 }
 
 
-#if NEVER
-// Generic driver handling any orders
+/***********************************************************************************************************************
+*** Mixed-radix NTT ****************************************************************************************************
+************************************************************************************************************************/
+
+// NTT of any order N dividing the group order (P-1 for GF(P)). The power-of-2 part of N is handled by the MFA_NTT, and odd factors
+// are split off one by one with the Cooley-Tukey algorithm. The plan should support the power-of-2 part of N.
+// Input-pruned transform: only the first NonZero inputs are non-zero, and initial contents of remaining blocks are ignored.
+// scratch[] provides N block pointers for TransposeMatrix. Input j is multiplied by in_scale[j] and output j by out_scale[j]
 template <typename T, T P>
-void Generic_NTT (T* data, size_t N, size_t SIZE, bool InvNTT)
+void Generic_NTT (T** data, size_t N, size_t SIZE, bool InvNTT, const NTTPlan<T,P>& plan, size_t NonZero, T** scratch,
+                  const BlockScale<T,P>& in_scale = BlockScale<T,P>(),  const BlockScale<T,P>& out_scale = BlockScale<T,P>())
 {
-    R = max. 2^n power of N
-    C = N/R
-    Employ PFA with R*C elements
-    0. fill roots[] with unity roots starting with root**R==1
-    1. MFA_NTT handles R-sized NTTs
-    2. PFA_NTT handles C-sized NTTs
+    assert ((GF_GroupOrder<T,P>() % N)  ==  0);
+    NonZero = std::max (std::min (NonZero, N), size_t(1));
+    if ((N & (N-1)) == 0) {
+        MFA_NTT<T,P> (data, N, SIZE, InvNTT, plan, NonZero, scratch, in_scale, out_scale);
+        return;
+    }
+
+    // Consider the data as matrix of F rows * M columns: data[r*M+c]
+    size_t F = (N%9==0? 9 : N%3==0? 3 : N%5==0? 5 : N%7==0? 7 : 13);
+    assert (N%F == 0);
+    size_t M = N/F;
+    T root = GF_Root<T,P>(N);
+    if (InvNTT)  root = GF_Inv<T,P>(root);
+
+    if (NonZero <= M) {
+        // 1+2. Only the first row is non-zero, so the NTT of column c just copies its first element into all rows,
+        // and then row r is multiplied by root(N) ** (r*c). Columns c>=NonZero are zero and skipped, as well as the rows below.
+        // The input scale factor is merged into these multiplications
+        ParallelFor (0, NonZero, [&] (ptrdiff_t c) {
+            in_scale.Prepare (data[c], c, SIZE);
+            T root_c = GF_Pow<T,P> (root, c),  root_rc = GF_Mul<T,P> (root_c, in_scale[c]);
+            for (size_t r=1; r<F; r++) {
+                GF_MulConst<T,P> (data[r*M+c], data[c], SIZE, root_rc, GF_MulConstPrecomp<T,P> (root_rc));
+                root_rc = GF_Mul<T,P> (root_rc, root_c);
+            }
+            in_scale.Multiply (data[c], c, SIZE);
+        });
+    } else {
+        // Codelets read all inputs, so zero the padding. The input scale factors are applied here too, since SmallNTT doesn't support them
+        ParallelFor (in_scale.Empty()? NonZero : 0,  N,  [&] (ptrdiff_t i) {
+            if (size_t(i) >= NonZero)
+                memset (data[i], 0, SIZE*sizeof(T));
+            else
+                in_scale.Apply (data[i], i, SIZE);
+        });
+
+        // 1. Apply a (length F) NTT on each column
+        if (InvNTT)  SmallNTT<T,P,true>  (data, F, M, SIZE);
+        else         SmallNTT<T,P,false> (data, F, M, SIZE);
+
+        // 2. Multiply each matrix element (index r,c) by root(N) ** (r*c)
+        ParallelFor (1, M, [&] (ptrdiff_t c) {
+            T root_c = GF_Pow<T,P> (root, c),  root_rc = root_c;
+            for (size_t r=1; r<F; r++) {
+                T* block = data[r*M+c];
+                GF_MulConst<T,P> (block, block, SIZE, root_rc, GF_MulConstPrecomp<T,P> (root_rc));
+                root_rc = GF_Mul<T,P> (root_rc, root_c);
+            }
+        });
+    }
+
+    // 3. Apply a (length M) NTT on each row, each one is a separate task using its own part of the scratch memory.
+    // Output k of the row r becomes the output r+k*F of the entire transform
+    ParallelFor (0, F, [&] (ptrdiff_t r) {
+        Generic_NTT<T,P> (data + r*M, M, SIZE, InvNTT, plan, NonZero, scratch + r*M, BlockScale<T,P>(), out_scale.Sub(r,F));
+    }, 1);
+
+    // 4. Transpose the matrix by transposing block pointers in the data[]
+    TransposeMatrix (data, F, M, scratch);
+}
+
+template <typename T, T P>
+void Generic_NTT (T** data, size_t N, size_t SIZE, bool InvNTT, const NTTPlan<T,P>& plan, size_t NonZero = size_t(-1))
+{
+    TransposeScratch<T,P> scratch (plan, N);
+    Generic_NTT<T,P> (data, N, SIZE, InvNTT, plan, NonZero, scratch.ptr);
+}
+
+template <typename T, T P>
+void Generic_NTT (T** data, size_t N, size_t SIZE, bool InvNTT)
+{
+    NTTPlan<T,P> plan(N & (0-N));     // the largest power of 2 dividing N
+    Generic_NTT<T,P> (data, N, SIZE, InvNTT, plan);
+}
+
+
+/***********************************************************************************************************************
+*** Contiguous layout **************************************************************************************************
+************************************************************************************************************************/
+
+// Move blocks of the contiguous buffer (block i starts at data+i*stride) so that block i receives the contents of the block ptrs[i] points to.
+// Each cycle of the permutation is followed with a single temporary block, so every block is copied only once.
+// Cycles are found by a serial pass over the pointers, then split into a few chunks per thread with about the same number of blocks
+template <typename T>
+void PermuteBlocks (T* data, T* const* ptrs, size_t N, size_t SIZE, size_t stride)
+{
+    std::vector<size_t> from (N);       // block j receives the contents of block from[j]
+    for (size_t j=0; j<N; j++)
+        from[j] = (ptrs[j]-data) / stride;
+
+    std::vector<size_t> cycles,  first;    // first block of every cycle, and number of blocks moved by the preceding cycles
+    std::vector<bool> visited (N, false);
+    size_t moved = 0;
+    for (size_t i=0; i<N; i++) {
+        if (visited[i]  ||  from[i] == i)  continue;    // already processed or stays in place
+        cycles.push_back(i);  first.push_back(moved);
+        for (size_t j=i; !visited[j]; j=from[j])
+            visited[j] = true,  moved++;
+    }
+    if (cycles.empty())  return;
+
+    size_t chunks = std::min (cycles.size(), 4*ThreadPool::Instance().Threads());
+    ParallelFor (0, chunks, [&] (ptrdiff_t k) {
+        size_t begin = std::lower_bound (first.begin(), first.end(), k*moved/chunks) - first.begin();
+        size_t end   = std::lower_bound (first.begin(), first.end(), (k+1)*moved/chunks) - first.begin();
+        std::vector<T> tmp (SIZE);
+        for (size_t c=begin; c<end; c++) {
+            size_t i = cycles[c],  j = i;
+            memcpy (tmp.data(), data+i*stride, SIZE*sizeof(T));
+            for (; from[j] != i; j=from[j])
+                memcpy (data+j*stride, data+from[j]*stride, SIZE*sizeof(T));
+            memcpy (data+j*stride, tmp.data(), SIZE*sizeof(T));
+        }
+    }, 1);
+}
+
+// NTT on the contiguous buffer: block i of SIZE elements starts at data+i*stride, stride>=SIZE.
+// The transform NTT(T** ptrs) is performed by the block-pointer version, then blocks are permuted in-place,
+// so the output is stored in the natural order
+template <typename T, typename Transform>
+void ContiguousNTT (T* data, size_t N, size_t SIZE, size_t stride, const Transform& NTT)
+{
+    std::vector<T*> ptrs (N);
+    for (size_t i=0; i<N; i++)
+        ptrs[i] = data + i*stride;
+    NTT (ptrs.data());
+    PermuteBlocks (data, ptrs.data(), N, SIZE, stride);
+}
+
+template <typename T, T P>
+void MFA_NTT (T* data, size_t N, size_t SIZE, size_t stride, bool InvNTT, const NTTPlan<T,P>& plan, size_t NonZero = size_t(-1))
+{
+    ContiguousNTT<T> (data, N, SIZE, stride, [&] (T** ptrs) {MFA_NTT<T,P> (ptrs, N, SIZE, InvNTT, plan, NonZero);});
+}
+
+template <typename T, T P>
+void Generic_NTT (T* data, size_t N, size_t SIZE, size_t stride, bool InvNTT, const NTTPlan<T,P>& plan, size_t NonZero = size_t(-1))
+{
+    ContiguousNTT<T> (data, N, SIZE, stride, [&] (T** ptrs) {Generic_NTT<T,P> (ptrs, N, SIZE, InvNTT, plan, NonZero);});
+}
+
+
+/***********************************************************************************************************************
+*** Batches of small transforms ****************************************************************************************
+************************************************************************************************************************/
+
+// Execute job(i, scratch) for each of count independent jobs, f.e. transforms of small stripes.
+// Jobs are split into a few chunks per thread, each chunk is processed by a single thread with nested parallelism disabled,
+// and owns scratch memory for SCRATCH block pointers, so there are no allocations or scheduling overheads per job
+template <typename T, typename Job>
+void ParallelBatch (size_t count, size_t SCRATCH, const Job& job)
+{
+    size_t chunks = std::min (count, 4*ThreadPool::Instance().Threads());
+    std::vector<T*> scratch (chunks*SCRATCH);
+    ParallelFor (0, chunks, [&] (ptrdiff_t k) {
+        SerialRegion serial;
+        for (size_t i = k*count/chunks;  i < (k+1)*count/chunks;  i++)
+            job (i, scratch.data() + k*SCRATCH);
+    }, 1);
+}
+
+// Perform count independent NTTs of order N with the same geometry and plan: transform i is applied to blocks data[i*N .. i*N+N-1]
+template <typename T, T P>
+void MFA_NTT_Batch (T** data, size_t count, size_t N, size_t SIZE, bool InvNTT, const NTTPlan<T,P>& plan)
+{
+    ParallelBatch<T> (count, N, [&] (size_t i, T** scratch) {
+        MFA_NTT<T,P> (data + i*N, N, SIZE, InvNTT, plan, size_t(-1), scratch);
+    });
+}
+
+
+/***********************************************************************************************************************
+*** Autotuning *********************************************************************************************************
+************************************************************************************************************************/
+
+// Average time (in ms) of the NTT execution, repeated until at least 100 ms are spent.
+// The NTT permutes block pointers, so their original order is restored prior to each run, keeping sequential memory access
+template <typename T>
+double AutotuneTime (T** data, size_t N, std::function<void()> NTT)
+{
+    std::vector<T*> order (data, data+N);
+    double start = GetTimer(), elapsed;
+    size_t runs = 0;
+    do {
+        memcpy (data, order.data(), N*sizeof(T*));
+        NTT();
+        runs++;
+    } while ((elapsed = GetTimer()-start) < 100);
+    memcpy (data, order.data(), N*sizeof(T*));
+    return elapsed/runs;
+}
+
+// Benchmark all R*C splits of the order-N MFA_NTT (including plain IterativeNTT) and all S values of the Rec_NTT for the given geometry,
+// and store the fastest ones into the wisdom. Sub-transforms of the R*C*L cube employ the wisdom for the order C when it's known,
+// so smaller orders should be tuned first. data[] should hold N blocks of SIZE elements, their contents are trashed
+template <typename T, T P>
+void NTT_Autotune (T** data, size_t N, size_t SIZE, const NTTPlan<T,P>& plan, bool print)
+{
+    size_t bytes = SIZE*sizeof(T),  best_value = 0;
+    double best_time = 0;
+    StartTimer();
+
+    // MFA_NTT, where R==0 means IterativeNTT
+    for (size_t R=0; R<=N/2; R = (R? 2*R : 2)) {
+        WisdomStore ("MFA_NTT", P, N, bytes, R);
+        double time = AutotuneTime<T> (data, N, [&]{MFA_NTT<T,P> (data, N, SIZE, false, plan);});
+        if (print)  printf("MFA_NTT R=%.0lf: %.3lf ms\n", R*1.0, time);
+        if (R==0 || time < best_time)  best_time = time,  best_value = R;
+    }
+    WisdomStore ("MFA_NTT", P, N, bytes, best_value);
+    if (print)  printf("MFA_NTT<%.0lf,%.0lf> R=%.0lf\n", N*1.0, bytes*1.0, best_value*1.0);
+
+    // Rec_NTT
+    for (size_t S=1; S<=N; S*=2) {
+        WisdomStore ("Rec_NTT", P, N, bytes, S);
+        double time = AutotuneTime<T> (data, N, [&]{Rec_NTT<T,P> (data, N, SIZE, false, plan);});
+        if (print)  printf("Rec_NTT S=%.0lf: %.3lf ms\n", S*1.0, time);
+        if (S==1 || time < best_time)  best_time = time,  best_value = S;
+    }
+    WisdomStore ("Rec_NTT", P, N, bytes, best_value);
+    if (print)  printf("Rec_NTT<%.0lf,%.0lf> S=%.0lf\n", N*1.0, bytes*1.0, best_value*1.0);
 }
-#endif